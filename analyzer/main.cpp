@@ -0,0 +1,223 @@
+#include "tinklarelayanalyzer.h"
+#include "tinklarelaybatchdecoder.h"
+#include "tinklarelayworkpool.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// Records per task. Large enough to amortize the task overhead, small enough to balance a single long trip
+const size_t DEFAULT_SLICE_RECORDS = 256 * 1024;
+const double DEFAULT_STUCK_SECONDS = 300;
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--threads N] [--stuck-seconds S] [--slice-records N] recording...\n"
+            "       %s --bench-decode N\n"
+            "Trip statistics and anomaly scan of " REL_RECORDING_MAGIC " recordings (tinklaRelayHUD --headless --format binary).\n"
+            "  --threads N          worker threads, default one per core\n"
+            "  --stuck-seconds S    blind spot warning held longer than this counts as stuck, default %.0f\n"
+            "  --slice-records N    records per task, default %zu\n"
+            "  --bench-decode N     check the batch decoder against TinklaRelayState on N random frames and print its throughput\n",
+            argv0, argv0, DEFAULT_STUCK_SECONDS, DEFAULT_SLICE_RECORDS);
+}
+
+// Field by field against the per-frame decoder, false on the first difference
+static bool sameAsState(const TinklaRelayColumns &c, size_t i, const TinklaRelayState &s)
+{
+    const bool flags[TinklaRelayColumns::NUM_FLAGS] = {
+        s.rel_gear_in_neutral, s.rel_option1_on, s.rel_option2_on, s.rel_option3_on,
+        s.rel_option4_on, s.rel_car_on, s.rel_gear_in_reverse, s.rel_gear_in_forward,
+        s.rel_brake_hold_on, s.rel_left_turn_signal, s.rel_right_turn_signal, s.rel_brake_pressed,
+        s.rel_highbeams_on, s.rel_light_on, s.rel_below_20mph, s.rel_use_imperial,
+        s.rel_tpms_alert_on, s.rel_left_steering_above_45deg, s.rel_right_steering_above_45deg, s.rel_AP_on,
+        s.rel_car_charging, s.rel_left_side_bsm, s.rel_right_side_bsm, s.rel_tacc_only_active
+    };
+    for (int f = 0; f < TinklaRelayColumns::NUM_FLAGS; ++f) {
+        if (c.flags[f][i] != static_cast<uint8_t>(flags[f])) {
+            return false;
+        }
+    }
+    return c.brightness[i] == s.rel_brightness && c.speed[i] == s.rel_speed && c.powerLvl[i] == s.rel_power_lvl
+        && c.accSpeed[i] == s.rel_acc_speed && c.speedLimit[i] == s.rel_speed_limit && c.accStatus[i] == s.rel_acc_status
+        && c.apAvailable[i] == static_cast<uint8_t>(s.rel_AP_available) && c.batteryLvl[i] == s.rel_battery_lvl;
+}
+
+// Frames per second of the per-frame decoder and of every batch decoder this CPU supports
+static int benchDecode(size_t count)
+{
+    std::vector<TinklaRelayRecord> records(count);
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < count; ++i) {
+        records[i].timestampUs = i * 200000;
+        for (int b = 0; b < REL_DATA_SIZE; ++b) {
+            records[i].data[b] = static_cast<uint8_t>(rng());
+        }
+    }
+    const uint8_t *frames = records[0].data;
+    const size_t stride = sizeof(TinklaRelayRecord);
+    const int REPEATS = 5;
+    typedef std::chrono::steady_clock Clock;
+
+    //baseline: what the HUD does per frame
+    std::vector<TinklaRelayState> states(count);
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; ++r) {
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            states[i].decode(records[i].data);
+        }
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    const double baseline = count / best;
+    printf("decoder\tM frames/s\tspeedup\n");
+    printf("TinklaRelayState\t%.1f\t1.00\n", baseline / 1e6);
+
+    int failures = 0;
+    TinklaRelayColumnStore store;
+    store.resize(count);
+    for (int isa = 0; isa < TinklaRelayBatchDecoder::NUM_ISAS; ++isa) {
+        TinklaRelayBatchDecoder::Isa which = static_cast<TinklaRelayBatchDecoder::Isa>(isa);
+        if (!TinklaRelayBatchDecoder::supported(which)) {
+            continue;
+        }
+        best = 1e30;
+        for (int r = 0; r < REPEATS; ++r) {
+            Clock::time_point t0 = Clock::now();
+            TinklaRelayBatchDecoder::decode(frames, stride, count, store.columns(), which);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+        }
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!sameAsState(store.columns(), i, states[i])) {
+                ++mismatches;
+            }
+        }
+        failures += mismatches > 0;
+        printf("batch %s\t%.1f\t%.2f%s\n", TinklaRelayBatchDecoder::name(which), count / best / 1e6,
+               count / best / baseline, mismatches > 0 ? "\tMISMATCH" : "");
+    }
+    return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    double stuckSeconds = DEFAULT_STUCK_SECONDS;
+    size_t sliceRecords = DEFAULT_SLICE_RECORDS;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stuck-seconds") == 0 && hasValue) {
+            stuckSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--slice-records") == 0 && hasValue) {
+            sliceRecords = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--bench-decode") == 0 && hasValue) {
+            return benchDecode(std::max<size_t>(1, static_cast<size_t>(strtoull(argv[++i], nullptr, 10))));
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || sliceRecords == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    uint64_t stuckUs = static_cast<uint64_t>(stuckSeconds * 1e6);
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<TinklaRelayRecordingFile>> files;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::unique_ptr<TinklaRelayRecordingFile> file(new TinklaRelayRecordingFile);
+        std::string error;
+        if (!file->open(paths[i], error)) {
+            fprintf(stderr, "%s: %s, skipped\n", paths[i].c_str(), error.c_str());
+            continue;
+        }
+        if (file->trailingBytes() != 0) {
+            fprintf(stderr, "%s: ignoring %zu bytes of a truncated last record\n", paths[i].c_str(), file->trailingBytes());
+        }
+        files.push_back(std::move(file));
+        names.push_back(paths[i]);
+    }
+
+    //one task per slice, every slice writes only its own result
+    struct Slice {
+        size_t file;
+        size_t begin;
+        size_t end;
+        TinklaRelayTripStats stats;
+    };
+    std::vector<Slice> slices;
+    std::vector<size_t> firstSlice(files.size() + 1);
+    uint64_t totalRecords = 0;
+    for (size_t f = 0; f < files.size(); ++f) {
+        firstSlice[f] = slices.size();
+        size_t count = files[f]->count();
+        totalRecords += count;
+        for (size_t begin = 0; begin < count; begin += sliceRecords) {
+            Slice slice;
+            slice.file = f;
+            slice.begin = begin;
+            slice.end = std::min(count, begin + sliceRecords);
+            slices.push_back(slice);
+        }
+    }
+    firstSlice[files.size()] = slices.size();
+    std::vector<TinklaRelayWorkPool::Task> tasks;
+    tasks.reserve(slices.size());
+    for (size_t s = 0; s < slices.size(); ++s) {
+        Slice *slice = &slices[s];
+        const TinklaRelayRecord *records = files[slice->file]->records();
+        tasks.push_back([slice, records, stuckUs]() {
+            tinklaRelayAnalyzeSlice(records, slice->begin, slice->end, stuckUs, slice->stats);
+        });
+    }
+    TinklaRelayWorkPool pool(threads);
+    pool.run(tasks);
+
+    printf("trip\tframes\thours\tkm\tmax_kmh\tkwh\tregen_kwh\tap_pct\tbattery\tbrakes\tdropouts\tclock_jumps\tgear_conflicts\tspeed_jumps\tstuck_bsm\tlongest_bsm_s\n");
+    TinklaRelayFleetStats fleet;
+    for (size_t f = 0; f < files.size(); ++f) {
+        TinklaRelayTripStats trip;
+        for (size_t s = firstSlice[f]; s < firstSlice[f + 1]; ++s) {
+            trip.merge(slices[s].stats, stuckUs);
+        }
+        trip.finish(stuckUs);
+        fleet.add(trip);
+        double hours = trip.spanUs / 3600e6;
+        printf("%s\t%llu\t%.2f\t%.1f\t%d\t%.2f\t%.2f\t%.1f\t%d-%d\t%llu\t%llu\t%llu\t%llu\t%llu\t%u\t%.0f\n",
+               names[f].c_str(), static_cast<unsigned long long>(trip.frames), hours, trip.distanceKm, trip.maxSpeedKmh,
+               trip.energyKwh, trip.regenKwh, trip.carOnSeconds > 0 ? 100 * trip.apSeconds / trip.carOnSeconds : 0.0,
+               trip.batteryStart, trip.batteryEnd, static_cast<unsigned long long>(trip.brakePresses),
+               static_cast<unsigned long long>(trip.dropouts), static_cast<unsigned long long>(trip.clockJumps),
+               static_cast<unsigned long long>(trip.gearConflicts), static_cast<unsigned long long>(trip.speedJumps),
+               trip.leftBsm.stuckRuns + trip.rightBsm.stuckRuns,
+               std::max(trip.leftBsm.longestUs, trip.rightBsm.longestUs) / 1e6);
+    }
+    printf("\nfleet: %llu trips, %llu frames, %.1f h recorded, %.1f h car on, %.1f km, max %d km/h, %.1f kWh used, %.1f kWh regenerated, AP %.1f%% of car-on time, %llu brake presses\n",
+           static_cast<unsigned long long>(fleet.trips), static_cast<unsigned long long>(fleet.frames), fleet.hours,
+           fleet.carOnSeconds / 3600, fleet.distanceKm, fleet.maxSpeedKmh, fleet.energyKwh, fleet.regenKwh,
+           fleet.carOnSeconds > 0 ? 100 * fleet.apSeconds / fleet.carOnSeconds : 0.0,
+           static_cast<unsigned long long>(fleet.brakePresses));
+    printf("anomalies: %llu trips affected, %llu dropouts, %llu clock jumps, %llu gear conflicts, %llu speed jumps, %llu stuck BSM runs\n",
+           static_cast<unsigned long long>(fleet.tripsWithAnomalies), static_cast<unsigned long long>(fleet.dropouts),
+           static_cast<unsigned long long>(fleet.clockJumps), static_cast<unsigned long long>(fleet.gearConflicts),
+           static_cast<unsigned long long>(fleet.speedJumps), static_cast<unsigned long long>(fleet.stuckBsmRuns));
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    fprintf(stderr, "%llu records in %.3f s on %d threads (%.1f M records/s)\n",
+            static_cast<unsigned long long>(totalRecords), seconds, pool.threads(), totalRecords / seconds / 1e6);
+    return fleet.tripsWithAnomalies > 0 ? 1 : 0;
+}
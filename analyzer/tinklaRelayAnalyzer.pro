@@ -0,0 +1,35 @@
+# Offline trip statistics and anomaly scan of binary recordings, see "Fleet analyzer" in README.md
+# Plain C++ with POSIX threads, it shares only the data message layout with the HUD
+
+TEMPLATE = app
+TARGET = tinklaRelayAnalyzer
+
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ..
+
+# Raspberry Pi OS armhf compilers default to ARMv6 without NEON, which leaves the batch decoder only its scalar path.
+# Every Pi from the Pi 2 on is ARMv7 with NEON, drop this line to build for a Pi 1 or Zero
+equals(QT_ARCH, arm): QMAKE_CXXFLAGS += -march=armv7-a -mfpu=neon
+
+SOURCES += \
+    ../tinklarelaybatchdecoder.cpp \
+    ../tinklarelaycolumnar.cpp \
+    ../tinklarelaystate.cpp \
+    main.cpp \
+    tinklarelayanalyzer.cpp \
+    tinklarelayworkpool.cpp
+
+HEADERS += \
+    ../tinklarelaybatchdecoder.h \
+    ../tinklarelaycolumnar.h \
+    ../tinklarelayrecording.h \
+    ../tinklarelaystate.h \
+    tinklarelayanalyzer.h \
+    tinklarelayworkpool.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
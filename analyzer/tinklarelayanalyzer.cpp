@@ -0,0 +1,417 @@
+// Includes
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tinklarelayanalyzer.h"
+#include "tinklarelaybatchdecoder.h"
+#include "tinklarelaycolumnar.h"
+
+const double KM_PER_MILE = 1.609344;
+const double US_PER_HOUR = 3600e6;
+// Records decoded into columns at a time by the trip scan, about 100 KB of columns
+const size_t SCAN_BLOCK_RECORDS = 4096;
+
+void TinklaRelayBitRun::closeRun(uint64_t startUs, uint64_t endUs, uint64_t stuckUs)
+{
+    uint64_t length = endUs > startUs ? endUs - startUs : 0;  // The clock may have been stepped back mid-run
+    longestUs = std::max(longestUs, length);
+    if (length > stuckUs) {
+        stuckRuns++;
+    }
+}
+
+void TinklaRelayBitRun::add(bool set, uint64_t timestampUs, uint64_t stuckUs)
+{
+    if (empty) {
+        empty = false;
+        firstUs = timestampUs;
+        firstSet = set;
+        allSet = set;
+        inRun_ = set;
+        inPrefix_ = set;
+        prefixEndUs = timestampUs;
+        suffixStartUs = timestampUs;
+    } else if (set) {
+        if (!inRun_) {
+            inRun_ = true;
+            suffixStartUs = timestampUs;
+        }
+        if (inPrefix_) {
+            prefixEndUs = timestampUs;
+        }
+    } else {
+        //the prefix run stays open for the previous slice to extend
+        if (inRun_ && !inPrefix_) {
+            closeRun(suffixStartUs, lastUs, stuckUs);
+        }
+        inRun_ = false;
+        inPrefix_ = false;
+        allSet = false;
+    }
+    lastUs = timestampUs;
+    lastSet = set;
+}
+
+void TinklaRelayBitRun::merge(const TinklaRelayBitRun &later, uint64_t stuckUs)
+{
+    if (later.empty) {
+        return;
+    }
+    if (empty) {
+        *this = later;
+        return;
+    }
+    longestUs = std::max(longestUs, later.longestUs);
+    stuckRuns += later.stuckRuns;
+    if (lastSet && later.firstSet) {
+        //one run spans the boundary
+        uint64_t startUs = allSet ? firstUs : suffixStartUs;
+        uint64_t endUs = later.allSet ? later.lastUs : later.prefixEndUs;
+        if (allSet && later.allSet) {
+            prefixEndUs = endUs;
+            suffixStartUs = startUs;
+        } else if (allSet) {
+            prefixEndUs = endUs;
+            suffixStartUs = later.suffixStartUs;
+        } else if (later.allSet) {
+            suffixStartUs = startUs;
+        } else {
+            closeRun(startUs, endUs, stuckUs);
+            suffixStartUs = later.suffixStartUs;
+        }
+        allSet = allSet && later.allSet;
+    } else {
+        if (lastSet && !allSet) {
+            closeRun(suffixStartUs, lastUs, stuckUs);
+        }
+        if (later.firstSet && !later.allSet) {
+            closeRun(later.firstUs, later.prefixEndUs, stuckUs);
+        }
+        suffixStartUs = later.suffixStartUs;
+        allSet = false;
+    }
+    lastSet = later.lastSet;
+    lastUs = later.lastUs;
+}
+
+void TinklaRelayBitRun::close(uint64_t stuckUs)
+{
+    if (empty) {
+        return;
+    }
+    if (allSet) {
+        closeRun(firstUs, lastUs, stuckUs);
+        return;
+    }
+    if (firstSet) {
+        closeRun(firstUs, prefixEndUs, stuckUs);
+    }
+    if (lastSet) {
+        closeRun(suffixStartUs, lastUs, stuckUs);
+    }
+}
+
+void TinklaRelayTripStats::merge(const TinklaRelayTripStats &later, uint64_t stuckUs)
+{
+    if (later.frames == 0) {
+        return;
+    }
+    if (frames == 0) {
+        firstUs = later.firstUs;
+        batteryStart = later.batteryStart;
+    }
+    frames += later.frames;
+    lastUs = later.lastUs;
+    spanUs += later.spanUs;
+    carOnSeconds += later.carOnSeconds;
+    apSeconds += later.apSeconds;
+    distanceKm += later.distanceKm;
+    energyKwh += later.energyKwh;
+    regenKwh += later.regenKwh;
+    maxSpeedKmh = std::max(maxSpeedKmh, later.maxSpeedKmh);
+    batteryEnd = later.batteryEnd;
+    brakePresses += later.brakePresses;
+    dropouts += later.dropouts;
+    clockJumps += later.clockJumps;
+    gearConflicts += later.gearConflicts;
+    speedJumps += later.speedJumps;
+    leftBsm.merge(later.leftBsm, stuckUs);
+    rightBsm.merge(later.rightBsm, stuckUs);
+}
+
+void TinklaRelayTripStats::finish(uint64_t stuckUs)
+{
+    leftBsm.close(stuckUs);
+    rightBsm.close(stuckUs);
+}
+
+void TinklaRelayFleetStats::add(const TinklaRelayTripStats &trip)
+{
+    trips++;
+    frames += trip.frames;
+    hours += trip.spanUs / US_PER_HOUR;
+    carOnSeconds += trip.carOnSeconds;
+    apSeconds += trip.apSeconds;
+    distanceKm += trip.distanceKm;
+    energyKwh += trip.energyKwh;
+    regenKwh += trip.regenKwh;
+    maxSpeedKmh = std::max(maxSpeedKmh, trip.maxSpeedKmh);
+    brakePresses += trip.brakePresses;
+    dropouts += trip.dropouts;
+    clockJumps += trip.clockJumps;
+    gearConflicts += trip.gearConflicts;
+    speedJumps += trip.speedJumps;
+    uint64_t stuck = trip.leftBsm.stuckRuns + trip.rightBsm.stuckRuns;
+    stuckBsmRuns += stuck;
+    if (trip.clockJumps + trip.gearConflicts + trip.speedJumps + stuck > 0) {
+        tripsWithAnomalies++;
+    }
+}
+
+TinklaRelayRecordingFile::TinklaRelayRecordingFile() :
+    map_(nullptr),
+    size_(0)
+{
+}
+
+TinklaRelayRecordingFile::~TinklaRelayRecordingFile()
+{
+    if (map_ != nullptr) {
+        munmap(map_, size_);
+    }
+}
+
+bool TinklaRelayRecordingFile::open(const std::string &path, std::string &error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < REL_RECORDING_MAGIC_LEN) {
+        error = "not a recording";
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        error = strerror(errno);
+        return false;
+    }
+    if (memcmp(map_, REL_COLUMNAR_MAGIC, REL_COLUMNAR_MAGIC_LEN) == 0) {
+        munmap(map_, size_);
+        map_ = nullptr;
+        return openColumnar(path, error);
+    }
+    if (memcmp(map_, REL_RECORDING_MAGIC, REL_RECORDING_MAGIC_LEN) != 0) {
+        error = "bad magic, not a " REL_RECORDING_MAGIC " or " REL_COLUMNAR_MAGIC " recording";
+        return false;
+    }
+    madvise(map_, size_, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool TinklaRelayRecordingFile::openColumnar(const std::string &path, std::string &error)
+{
+    TinklaRelayColumnarReader reader;
+    if (!reader.open(path.c_str())) {
+        error = "cannot read " REL_COLUMNAR_MAGIC " recording";
+        return false;
+    }
+    if (!reader.hadIndex()) {
+        fprintf(stderr, "%s: no block index (recording cut short?), rebuilt it from %zu intact blocks\n", path.c_str(), reader.blocks());
+    }
+    decoded_.resize(reader.records());
+    size_t at = 0;
+    for (size_t i = 0; i < reader.blocks(); ++i) {
+        if (!reader.readBlock(i, decoded_.data() + at)) {
+            error = "corrupt block";
+            return false;
+        }
+        at += reader.block(i).records;
+    }
+    return true;
+}
+
+const TinklaRelayRecord *TinklaRelayRecordingFile::records() const
+{
+    if (!decoded_.empty()) {
+        return decoded_.data();
+    }
+    return reinterpret_cast<const TinklaRelayRecord *>(static_cast<const char *>(map_) + REL_RECORDING_MAGIC_LEN);
+}
+
+size_t TinklaRelayRecordingFile::count() const
+{
+    if (!decoded_.empty()) {
+        return decoded_.size();
+    }
+    return map_ == nullptr ? 0 : (size_ - REL_RECORDING_MAGIC_LEN) / sizeof(TinklaRelayRecord);
+}
+
+size_t TinklaRelayRecordingFile::trailingBytes() const
+{
+    return map_ == nullptr ? 0 : (size_ - REL_RECORDING_MAGIC_LEN) % sizeof(TinklaRelayRecord);
+}
+
+static int speedKmh(uint8_t speed, bool imperial)
+{
+    return imperial ? static_cast<int>(speed * KM_PER_MILE + 0.5) : speed;
+}
+
+// The signals of one record the trip scan uses
+struct ScanRecord {
+    uint64_t timestampUs = 0;
+    int kmh = 0;
+    int power = 0;
+    int battery = 0;
+    int gears = 0;  // Gear flags set, more than one is a conflict
+    bool carOn = false;
+    bool apOn = false;
+    bool brake = false;
+    bool leftBsm = false;
+    bool rightBsm = false;
+};
+
+// Adds record cur to the statistics, the values of prev hold until cur
+static inline void scanRecord(const ScanRecord &cur, const ScanRecord &prev, bool havePrev, uint64_t stuckUs, TinklaRelayTripStats &out)
+{
+    uint64_t nowUs = cur.timestampUs;
+    if (out.batteryStart < 0) {
+        out.batteryStart = cur.battery;
+    }
+    out.batteryEnd = cur.battery;
+    out.maxSpeedKmh = std::max(out.maxSpeedKmh, cur.kmh);
+    if (cur.gears > 1) {
+        out.gearConflicts++;
+    }
+    out.leftBsm.add(cur.leftBsm, nowUs, stuckUs);
+    out.rightBsm.add(cur.rightBsm, nowUs, stuckUs);
+    if (!havePrev) {
+        return;
+    }
+    uint64_t prevUs = prev.timestampUs;
+    if (nowUs >= prevUs) {
+        out.spanUs += nowUs - prevUs;
+    }
+    if (nowUs < prevUs) {
+        out.clockJumps++;
+    } else if (nowUs - prevUs > DROPOUT_US) {
+        out.dropouts++;
+    } else {
+        double dtUs = static_cast<double>(nowUs - prevUs);
+        if (prev.carOn) {
+            out.carOnSeconds += dtUs / 1e6;
+        }
+        if (prev.apOn) {
+            out.apSeconds += dtUs / 1e6;
+        }
+        out.distanceKm += prev.kmh * dtUs / US_PER_HOUR;
+        if (prev.power > 0) {
+            out.energyKwh += prev.power * dtUs / US_PER_HOUR;
+        } else {
+            out.regenKwh -= prev.power * dtUs / US_PER_HOUR;
+        }
+        int jump = abs(cur.kmh - prev.kmh);
+        if (jump >= MIN_SPEED_JUMP_KMH && jump * 1e6 > MAX_SPEED_RATE_KMH_PER_S * dtUs) {
+            out.speedJumps++;
+        }
+    }
+    if (cur.brake && !prev.brake) {
+        out.brakePresses++;
+    }
+}
+
+// One TinklaRelayState per record, faster than the batch decoder when it has no SIMD path for this CPU
+static void scanStates(const TinklaRelayRecord *records, size_t begin, size_t end, uint64_t stuckUs, TinklaRelayTripStats &out)
+{
+    ScanRecord prev;
+    bool havePrev = false;
+    for (size_t i = begin > 0 ? begin - 1 : begin; i < end; ++i) {
+        TinklaRelayState state;
+        state.decode(records[i].data);
+        ScanRecord cur;
+        cur.timestampUs = records[i].timestampUs;
+        cur.kmh = speedKmh(state.rel_speed, state.rel_use_imperial);
+        cur.power = state.rel_power_lvl;
+        cur.battery = state.rel_battery_lvl;
+        cur.gears = state.rel_gear_in_reverse + state.rel_gear_in_forward + state.rel_gear_in_neutral;
+        cur.carOn = state.rel_car_on;
+        cur.apOn = state.rel_AP_on;
+        cur.brake = state.rel_brake_pressed;
+        cur.leftBsm = state.rel_left_side_bsm;
+        cur.rightBsm = state.rel_right_side_bsm;
+        if (i >= begin) {
+            scanRecord(cur, prev, havePrev, stuckUs, out);
+        }
+        prev = cur;
+        havePrev = true;
+    }
+}
+
+// The slice is decoded a block at a time into columns that stay in cache, and only the signals used here are read
+static void scanColumns(const TinklaRelayRecord *records, size_t begin, size_t end, uint64_t stuckUs, TinklaRelayTripStats &out)
+{
+    TinklaRelayColumnStore store;
+    store.resize(SCAN_BLOCK_RECORDS);
+    const TinklaRelayColumns &c = store.columns();
+    const uint8_t *carOn = c.flags[TinklaRelayColumns::flagIndex(0, REL_CAR_ON)];
+    const uint8_t *reverse = c.flags[TinklaRelayColumns::flagIndex(0, REL_GEAR_IN_REVERSE)];
+    const uint8_t *forward = c.flags[TinklaRelayColumns::flagIndex(0, REL_GEAR_IN_FORWARD)];
+    const uint8_t *neutral = c.flags[TinklaRelayColumns::flagIndex(0, REL_GEAR_IN_NEUTRAL)];
+    const uint8_t *brakePressed = c.flags[TinklaRelayColumns::flagIndex(1, REL_BRAKE_PRESSED)];
+    const uint8_t *imperial = c.flags[TinklaRelayColumns::flagIndex(1, REL_USE_IMPERIAL_FOR_SPEED)];
+    const uint8_t *apOn = c.flags[TinklaRelayColumns::flagIndex(2, REL_AP_ON)];
+    const uint8_t *leftBsm = c.flags[TinklaRelayColumns::flagIndex(2, REL_LEFT_SIDE_BSM)];
+    const uint8_t *rightBsm = c.flags[TinklaRelayColumns::flagIndex(2, REL_RIGHT_SIDE_BSM)];
+    ScanRecord prev;
+    bool havePrev = false;
+    for (size_t block = begin > 0 ? begin - 1 : begin; block < end; block += SCAN_BLOCK_RECORDS) {
+        size_t count = std::min(SCAN_BLOCK_RECORDS, end - block);
+        TinklaRelayBatchDecoder::decode(records[block].data, sizeof(TinklaRelayRecord), count, c);
+        for (size_t j = 0; j < count; ++j) {
+            ScanRecord cur;
+            cur.timestampUs = records[block + j].timestampUs;
+            cur.kmh = speedKmh(c.speed[j], imperial[j] != 0);
+            cur.power = c.powerLvl[j];
+            cur.battery = c.batteryLvl[j];
+            cur.gears = reverse[j] + forward[j] + neutral[j];
+            cur.carOn = carOn[j] != 0;
+            cur.apOn = apOn[j] != 0;
+            cur.brake = brakePressed[j] != 0;
+            cur.leftBsm = leftBsm[j] != 0;
+            cur.rightBsm = rightBsm[j] != 0;
+            if (block + j >= begin) {
+                scanRecord(cur, prev, havePrev, stuckUs, out);
+            }
+            prev = cur;
+            havePrev = true;
+        }
+    }
+}
+
+void tinklaRelayAnalyzeSlice(const TinklaRelayRecord *records, size_t begin, size_t end, uint64_t stuckUs, TinklaRelayTripStats &out)
+{
+    if (begin >= end) {
+        return;
+    }
+    out.firstUs = records[begin].timestampUs;
+    //the scalar batch decode writes 32 columns per frame and is slower than filling one TinklaRelayState
+    if (TinklaRelayBatchDecoder::best() == TinklaRelayBatchDecoder::ISA_SCALAR) {
+        scanStates(records, begin, end, stuckUs, out);
+    } else {
+        scanColumns(records, begin, end, stuckUs, out);
+    }
+    out.frames += end - begin;
+    out.lastUs = records[end - 1].timestampUs;
+}
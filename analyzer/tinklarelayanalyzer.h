@@ -0,0 +1,113 @@
+#ifndef TINKLARELAYANALYZER_H
+#define TINKLARELAYANALYZER_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "tinklarelayrecording.h"
+
+// Gap between two records that counts as a dropout rather than an interval to integrate over
+const uint64_t DROPOUT_US = 2000000;
+// Speed change per second no car can do, anything faster is a decoding or wiring problem
+const int MAX_SPEED_RATE_KMH_PER_S = 60;
+const int MIN_SPEED_JUMP_KMH = 10;
+
+// Runs of consecutive records with one bit set, kept in a form that can be merged chunk by chunk
+// A run touching either edge of a chunk stays open until the neighbouring chunk is merged in
+struct TinklaRelayBitRun {
+    bool empty = true;
+    bool firstSet = false;
+    bool lastSet = false;
+    bool allSet = false;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t prefixEndUs = 0;    // End of the run starting at the first record, if firstSet
+    uint64_t suffixStartUs = 0;  // Start of the run ending at the last record, if lastSet
+    uint64_t longestUs = 0;      // Longest closed run
+    uint32_t stuckRuns = 0;      // Closed runs longer than the stuck limit
+
+    void add(bool set, uint64_t timestampUs, uint64_t stuckUs);
+    void merge(const TinklaRelayBitRun &later, uint64_t stuckUs);
+    void close(uint64_t stuckUs);  // End of the trip, closes the edge runs
+private:
+    bool inRun_ = false;
+    bool inPrefix_ = false;
+    void closeRun(uint64_t startUs, uint64_t endUs, uint64_t stuckUs);
+};
+
+// Statistics of one trip (one recording), or of a slice of one while it is being analyzed
+struct TinklaRelayTripStats {
+    uint64_t frames = 0;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t spanUs = 0;          // Sum of the forward gaps between records, a clock stepping back adds nothing
+    double carOnSeconds = 0;
+    double apSeconds = 0;
+    double distanceKm = 0;
+    double energyKwh = 0;
+    double regenKwh = 0;
+    int maxSpeedKmh = 0;
+    int batteryStart = -1;
+    int batteryEnd = -1;
+    uint64_t brakePresses = 0;
+    // Anomalies
+    uint64_t dropouts = 0;        // Gaps longer than DROPOUT_US
+    uint64_t clockJumps = 0;      // Timestamps going backwards
+    uint64_t gearConflicts = 0;   // Records with more than one of reverse/forward/neutral set
+    uint64_t speedJumps = 0;      // Speed changes faster than MAX_SPEED_RATE_KMH_PER_S
+    TinklaRelayBitRun leftBsm;
+    TinklaRelayBitRun rightBsm;
+
+    void merge(const TinklaRelayTripStats &later, uint64_t stuckUs);  // later must directly follow this slice
+    void finish(uint64_t stuckUs);
+};
+
+// Fleet-wide totals of finished trips
+struct TinklaRelayFleetStats {
+    uint64_t trips = 0;
+    uint64_t frames = 0;
+    double hours = 0;
+    double carOnSeconds = 0;
+    double apSeconds = 0;
+    double distanceKm = 0;
+    double energyKwh = 0;
+    double regenKwh = 0;
+    int maxSpeedKmh = 0;
+    uint64_t brakePresses = 0;
+    uint64_t dropouts = 0;
+    uint64_t clockJumps = 0;
+    uint64_t gearConflicts = 0;
+    uint64_t speedJumps = 0;
+    uint64_t stuckBsmRuns = 0;
+    uint64_t tripsWithAnomalies = 0;
+
+    void add(const TinklaRelayTripStats &trip);
+};
+
+// Read-only mapping of one TRREC001 recording. Columnar (TRCOL001) recordings are decoded into memory instead
+class TinklaRelayRecordingFile
+{
+public:
+    TinklaRelayRecordingFile();
+    ~TinklaRelayRecordingFile();
+
+    bool open(const std::string &path, std::string &error);
+    const TinklaRelayRecord *records() const;
+    size_t count() const;
+    size_t trailingBytes() const;  // Bytes of an incomplete last record, e.g. a recording cut off mid-write
+private:
+    void *map_;
+    size_t size_;
+    std::vector<TinklaRelayRecord> decoded_;
+    bool openColumnar(const std::string &path, std::string &error);
+    TinklaRelayRecordingFile(const TinklaRelayRecordingFile &) = delete;
+    TinklaRelayRecordingFile &operator=(const TinklaRelayRecordingFile &) = delete;
+};
+
+// Analyzes records [begin, end). Looks back at record begin - 1 so intervals crossing
+// the slice boundary are counted exactly once, by the later slice
+void tinklaRelayAnalyzeSlice(const TinklaRelayRecord *records, size_t begin, size_t end, uint64_t stuckUs, TinklaRelayTripStats &out);
+
+#endif // TINKLARELAYANALYZER_H
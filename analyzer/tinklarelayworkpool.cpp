@@ -0,0 +1,73 @@
+// Includes
+#include <thread>
+#include "tinklarelayworkpool.h"
+
+TinklaRelayWorkPool::TinklaRelayWorkPool(int threads) :
+    threads_(threads > 0 ? threads : 1)
+{
+    for (int i = 0; i < threads_; ++i) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+}
+
+int TinklaRelayWorkPool::threads() const
+{
+    return threads_;
+}
+
+void TinklaRelayWorkPool::run(std::vector<Task> &tasks)
+{
+    //deal the tasks out round robin, stealing evens out whatever that gets wrong
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        queues_[i % threads_]->tasks.push_back(&tasks[i]);
+    }
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads_; ++i) {
+        workers.push_back(std::thread(&TinklaRelayWorkPool::work, this, i));
+    }
+    work(0);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+void TinklaRelayWorkPool::work(int self)
+{
+    //tasks never create tasks, so once every queue is empty there is nothing left to wait for
+    for (;;) {
+        Task *task = popOwn(self);
+        if (task == nullptr) {
+            task = steal(self);
+        }
+        if (task == nullptr) {
+            return;
+        }
+        (*task)();
+    }
+}
+
+TinklaRelayWorkPool::Task *TinklaRelayWorkPool::popOwn(int self)
+{
+    Queue &queue = *queues_[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return nullptr;
+    }
+    Task *task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return task;
+}
+
+TinklaRelayWorkPool::Task *TinklaRelayWorkPool::steal(int self)
+{
+    for (int i = 1; i < threads_; ++i) {
+        Queue &victim = *queues_[(self + i) % threads_];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Task *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return task;
+        }
+    }
+    return nullptr;
+}
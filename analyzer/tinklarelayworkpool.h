@@ -0,0 +1,35 @@
+#ifndef TINKLARELAYWORKPOOL_H
+#define TINKLARELAYWORKPOOL_H
+
+// Includes
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed set of threads with one task deque each. A worker takes its own tasks from the back
+// and, once it runs dry, steals from the front of the others, so uneven files still keep every core busy
+class TinklaRelayWorkPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit TinklaRelayWorkPool(int threads);
+
+    int threads() const;
+    void run(std::vector<Task> &tasks);  // Blocks until every task has run
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task *> tasks;
+    };
+    int threads_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    void work(int self);
+    Task *popOwn(int self);
+    Task *steal(int self);
+};
+
+#endif // TINKLARELAYWORKPOOL_H
@@ -1,4 +1,10 @@
 #include "tinklarelayhud.h"
+#include "tinklarelayfaultinjection.h"
+#include "tinklarelayassets.h"
+#include "tinklarelaystream.h"
+#include "tinklarelayalloccheck.h"
+#include "tinklarelaybootprofile.h"
+#include "tinklarelayenergygauge.h"
 
 #include <QApplication>
 #include <stdio.h>
@@ -8,18 +14,104 @@
 
 int main(int argc, char *argv[])
 {
+   TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_MAIN);
+   QStringList arguments;
+   for (int i = 0; i < argc; ++i) {
+       arguments << QString::fromLocal8Bit(argv[i]);
+   }
+   QCommandLineParser parser;
+   QCommandLineOption soakOption("soak", "Run the USB fault-injection soak test for <hours> of simulated time, print the report and exit.", "hours");
+   QCommandLineOption seedOption("seed", "Seed of the --soak fault schedule.", "seed", "1");
+   QCommandLineOption packAssetsOption("pack-assets", "Write the pre-decoded image blob to <file> and exit (build step).", "file");
+   QCommandLineOption measureAssetsOption("measure-assets", "Load the images from the blob <file> and from the PNGs, print the time and memory each takes and exit.", "file");
+   QCommandLineOption checkGaugeOption("check-gauge", "Compare the energy gauge tables with the floating point math they replaced, exit with 1 on a difference above 1.");
+   QCommandLineOption headlessOption("headless", "Run acquisition only, without the HUD, and stream decoded frames.");
+   QCommandLineOption formatOption("format", "Headless output format: json, binary or columnar.", "format", "json");
+   QCommandLineOption outputOption("output", "Headless output: - for stdout, or a file/FIFO path.", "path", "-");
+   QCommandLineOption intervalOption("interval", "Headless poll period in ms, 0 polls as fast as the relay answers.", "ms", "0");
+   QCommandLineOption flushOption("flush-interval", "Longest time in ms a headless frame is buffered before it is written (default 100, 60000 for columnar).", "ms");
+   QCommandLineOption shmOption("shm-name", "Shared memory segment headless mode publishes live state to, empty for none.", "name", REL_SHM_DEFAULT_NAME);
+   parser.addOption(soakOption);
+   parser.addOption(seedOption);
+   parser.addOption(packAssetsOption);
+   parser.addOption(measureAssetsOption);
+   parser.addOption(checkGaugeOption);
+   parser.addOption(headlessOption);
+   parser.addOption(formatOption);
+   parser.addOption(outputOption);
+   parser.addOption(intervalOption);
+   parser.addOption(flushOption);
+   parser.addOption(shmOption);
+#ifdef TINKLA_ALLOC_CHECK
+   QCommandLineOption allocCheckOption("alloc-check", "Run the HUD against a simulated drive for <seconds> and fail if a frame allocates.", "seconds");
+   parser.addOption(allocCheckOption);
+#endif
+   parser.addPositionalArgument("brightness", "Backlight brightness control file.");
+   parser.parse(arguments);  // Unknown options are left for QApplication (e.g. -platform)
+
+   if (parser.isSet(soakOption)) {
+       TinklaRelaySoakOptions options;
+       options.hours = parser.value(soakOption).toDouble();
+       options.seed = parser.value(seedOption).toUInt();
+       options.pollIntervalMs = 200;
+       options.stuckLimitMs = 10000;
+       return tinklaRelayRunSoak(options);
+   }
+#ifdef TINKLA_ALLOC_CHECK
+   if (parser.isSet(allocCheckOption)) {
+       return tinklaRelayRunAllocCheck(argc, argv, parser.value(allocCheckOption).toInt());
+   }
+#endif
+   if (parser.isSet(checkGaugeOption)) {
+       return tinklaRelayCheckEnergyGauge();
+   }
+   if (parser.isSet(packAssetsOption)) {
+       return TinklaRelayAssets::pack(parser.value(packAssetsOption)) ? 0 : 1;
+   }
+   if (parser.isSet(measureAssetsOption)) {
+       if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+           qputenv("QT_QPA_PLATFORM", "offscreen");  // No display needed
+       }
+       QApplication a(argc, argv);
+       return TinklaRelayAssets::measure(parser.value(measureAssetsOption));
+   }
+   if (parser.isSet(headlessOption)) {
+       TinklaRelayHeadlessOptions options;
+       options.output = parser.value(outputOption);
+       QString format = parser.value(formatOption);
+       if (format == "json") {
+           options.format = TinklaRelayStreamWriter::FORMAT_JSON;
+       } else if (format == "binary") {
+           options.format = TinklaRelayStreamWriter::FORMAT_BINARY;
+       } else if (format == "columnar") {
+           options.format = TinklaRelayStreamWriter::FORMAT_COLUMNAR;
+       } else {
+           fprintf(stderr, "Unknown --format %s, expected json, binary or columnar\n", qPrintable(format));
+           return 1;
+       }
+       options.intervalMs = parser.value(intervalOption).toInt();
+       //small columnar blocks compress badly, so they are closed far less often by default
+       options.flushIntervalMs = parser.isSet(flushOption) ? parser.value(flushOption).toInt()
+                                 : (options.format == TinklaRelayStreamWriter::FORMAT_COLUMNAR ? 60000 : 100);
+       options.shmName = parser.value(shmOption);
+       return tinklaRelayRunHeadless(options);
+   }
    int result = 0;
    do
       {
         QApplication a(argc, argv);
+        TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_APPLICATION);
+        //QApplication has taken out its own options (-platform linuxfb, ...), only now is the first positional ours
+        parser.parse(QCoreApplication::arguments());
+        QString brightnessPath = parser.positionalArguments().value(0);
         TinklaRelayHUD w;
         w.setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
         w.show();
         w.drawHud();
         w.startSpinnerTimer(50);
         w.startUsbTimer(200);
-        if (argc > 1) {
-            w.setBrightnessControllPath(argv[1]);
+        if (!brightnessPath.isEmpty()) {
+            w.setBrightnessControllPath(brightnessPath);
         }
         result =  a.exec();
      } while( result == 1337 );
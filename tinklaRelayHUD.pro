@@ -1,8 +1,8 @@
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++11
+CONFIG += c++14
 
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
@@ -18,15 +18,57 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
     libusb-extra.c \
     main.cpp \
+    tinklarelayacquisition.cpp \
+    tinklarelayassets.cpp \
+    tinklarelayboot.cpp \
+    tinklarelaybootprofile.cpp \
+    tinklarelaycolumnar.cpp \
+    tinklarelayconnection.cpp \
     tinklarelaydriver.cpp \
+    tinklarelayenergygauge.cpp \
+    tinklarelayfaultinjection.cpp \
+    tinklarelayframecache.cpp \
     tinklarelayhud.cpp \
-    tinklarelayhudsettings.cpp
+    tinklarelayhudsettings.cpp \
+    tinklarelaymetrics.cpp \
+    tinklarelayperfoverlay.cpp \
+    tinklarelayrenderworker.cpp \
+    tinklarelayscreenmode.cpp \
+    tinklarelayshm.cpp \
+    tinklarelaystate.cpp \
+    tinklarelaystream.cpp \
+    tinklarelaytrace.cpp \
+    tinklarelayusbbackend.cpp \
+    tinklarelaywarmstart.cpp \
+    tinklarelaywatchdog.cpp
 
 HEADERS += \
     libusb-extra.h \
+    tinklarelayacquisition.h \
+    tinklarelayalloccheck.h \
+    tinklarelayassets.h \
+    tinklarelayboot.h \
+    tinklarelaybootprofile.h \
+    tinklarelaycolumnar.h \
+    tinklarelayconnection.h \
     tinklarelaydriver.h \
+    tinklarelayenergygauge.h \
+    tinklarelayfaultinjection.h \
+    tinklarelayframecache.h \
     tinklarelayhud.h \
-    tinklarelayhudsettings.h
+    tinklarelayhudsettings.h \
+    tinklarelaymetrics.h \
+    tinklarelayperfoverlay.h \
+    tinklarelayrecording.h \
+    tinklarelayrenderworker.h \
+    tinklarelayscreenmode.h \
+    tinklarelayshm.h \
+    tinklarelaystate.h \
+    tinklarelaystream.h \
+    tinklarelaytrace.h \
+    tinklarelayusbbackend.h \
+    tinklarelaywarmstart.h \
+    tinklarelaywatchdog.h
 
 FORMS += \
     tinklarelayhud.ui \
@@ -41,7 +83,22 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 RESOURCES += \
-    tinklaRelayHUD.qrc \
     tinklaRelayHUD.qrc
 
+# Pre-decode the images into tinklaRelayHUD.assets next to the binary, see tinklarelayassets.h
+# When cross-compiling, run "tinklaRelayHUD --pack-assets tinklaRelayHUD.assets" once on the target instead
+!cross_compile {
+    QMAKE_POST_LINK += $$shell_quote($$OUT_PWD/$$TARGET) --pack-assets $$shell_quote($$OUT_PWD/tinklaRelayHUD.assets)
+}
+assets.files = $$OUT_PWD/tinklaRelayHUD.assets
+assets.path = $$target.path
+assets.CONFIG += no_check_exist
+!isEmpty(target.path): INSTALLS += assets
+
 LIBS += -lusb-1.0
+
+# "qmake CONFIG+=alloccheck" builds a binary whose --alloc-check <seconds> fails if a steady-state frame allocates
+alloccheck {
+    DEFINES += TINKLA_ALLOC_CHECK
+    SOURCES += tinklarelayalloccheck.cpp
+}
@@ -0,0 +1,180 @@
+// Includes
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "tinklarelayacquisition.h"
+#include "tinklarelayalloccheck.h"
+#include "tinklarelayconnection.h"
+#include "tinklarelaymetrics.h"
+#include "tinklarelayshm.h"
+#include "tinklarelaytrace.h"
+
+// Stack reserved for the acquisition thread, all of it is touched up front when memory is locked
+const int ACQUISITION_STACK_SIZE = 256 * 1024;
+
+static void addMs(timespec &ts, int ms)
+{
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += static_cast<long>(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+}
+
+static qint64 diffUs(const timespec &a, const timespec &b)
+{
+    return static_cast<qint64>(a.tv_sec - b.tv_sec) * 1000000 + (a.tv_nsec - b.tv_nsec) / 1000;
+}
+
+static void prefaultStack()
+{
+    //leave headroom for the frames already on the stack
+    volatile char touch[ACQUISITION_STACK_SIZE - 32 * 1024];
+    memset(const_cast<char *>(touch), 0, sizeof(touch));
+}
+
+TinklaRelayAcquisitionThread::TinklaRelayAcquisitionThread(const TinklaRelayRealtimeOptions &options, TinklaRelayShmPublisher *publisher, QObject *parent) :
+    QThread(parent),
+    options_(options),
+    publisher_(publisher),
+    seq_(0),
+    decodedNs_(0),
+    stopRequested_(false)
+{
+    setStackSize(ACQUISITION_STACK_SIZE);
+}
+
+TinklaRelayAcquisitionThread::~TinklaRelayAcquisitionThread()
+{
+    stop();
+}
+
+void TinklaRelayAcquisitionThread::stop()
+{
+    stopRequested_.store(true, std::memory_order_relaxed);
+    wait();
+}
+
+bool TinklaRelayAcquisitionThread::latest(TinklaRelayState &state, quint64 *decodedNs) const
+{
+    for (;;) {
+        quint32 before = seq_.load(std::memory_order_acquire);
+        if (before == 0) {
+            return false;
+        }
+        if (before & 1u) {
+            continue;
+        }
+        memcpy(static_cast<void *>(&state), &state_, sizeof(TinklaRelayState));
+        quint64 stamp = decodedNs_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == before) {
+            if (decodedNs != nullptr) {
+                *decodedNs = stamp;
+            }
+            return true;
+        }
+    }
+}
+
+void TinklaRelayAcquisitionThread::store(const TinklaRelayState &state, quint64 decodedNs)
+{
+    seq_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(static_cast<void *>(&state_), &state, sizeof(TinklaRelayState));
+    decodedNs_ = decodedNs;
+    seq_.fetch_add(1, std::memory_order_release);
+}
+
+void TinklaRelayAcquisitionThread::setupRealtime()
+{
+    if (options_.lockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            fprintf(stderr, "Real-time acquisition: mlockall failed: %s\n", strerror(errno));
+        }
+        prefaultStack();
+    }
+    if (options_.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options_.cpu, &cpus);
+        int r = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (r != 0) {
+            fprintf(stderr, "Real-time acquisition: cannot pin to CPU %d: %s\n", options_.cpu, strerror(r));
+        }
+    }
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = options_.priority;
+    int r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (r != 0) {
+        fprintf(stderr, "Real-time acquisition: SCHED_FIFO priority %d refused: %s\n", options_.priority, strerror(r));
+    }
+}
+
+void TinklaRelayAcquisitionThread::run()
+{
+    TinklaRelayTrace::setThreadName("acquisition");
+    setupRealtime();
+    TinklaRelayDriver driver;
+    TinklaRelayConnection connection(driver);
+    TinklaRelayHistogram &lateness = TinklaRelayMetrics::instance().acquisitionLateness;
+    quint64 wakeups = 0;
+    qint64 sumUs = 0;
+    qint64 maxUs = 0;
+    quint64 overMs = 0;
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (!stopRequested_.load(std::memory_order_relaxed)) {
+        TINKLA_ALLOC_FRAME("acquisition");
+        bool gotData = false;
+        switch (connection.poll(&gotData)) {
+            case TinklaRelayConnection::EVENT_CONNECTED:
+                emit connectionChanged(true);
+                break;
+            case TinklaRelayConnection::EVENT_DISCONNECTED:
+                if (publisher_ != nullptr) {
+                    publisher_->setConnected(false);
+                }
+                emit connectionChanged(false);
+                break;
+            default:
+                break;
+        }
+        if (gotData) {
+            store(driver.state, TinklaRelayTrace::nowNs());
+            if (publisher_ != nullptr) {
+                publisher_->publish(TinklaRelayShmPublisher::realtimeUs(), driver.rawData(), driver.state);
+            }
+        }
+        addMs(deadline, connection.connected() ? options_.periodMs : options_.searchMs);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (diffUs(now, deadline) > 0) {
+            //overran a whole period (e.g. a slow reconnect), restart the schedule instead of bursting to catch up
+            deadline = now;
+            continue;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        qint64 lateUs = diffUs(now, deadline);
+        lateness.observe(static_cast<quint64>(lateUs));
+        wakeups++;
+        sumUs += lateUs;
+        maxUs = qMax(maxUs, lateUs);
+        if (lateUs > 1000) {
+            overMs++;
+        }
+    }
+    if (wakeups > 0) {
+        fprintf(stderr, "Real-time acquisition: %llu wake-ups, lateness mean %lld us, max %lld us, %llu over 1 ms\n",
+                static_cast<unsigned long long>(wakeups), static_cast<long long>(sumUs / static_cast<qint64>(wakeups)),
+                static_cast<long long>(maxUs), static_cast<unsigned long long>(overMs));
+    }
+}
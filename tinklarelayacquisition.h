@@ -0,0 +1,52 @@
+#ifndef TINKLARELAYACQUISITION_H
+#define TINKLARELAYACQUISITION_H
+
+// Includes
+#include <QThread>
+#include <atomic>
+#include "tinklarelaystate.h"
+
+class TinklaRelayShmPublisher;
+
+struct TinklaRelayRealtimeOptions {
+    int priority;      // SCHED_FIFO priority, 1..99
+    int cpu;           // Core to pin the thread to, -1 leaves it unpinned
+    int periodMs;      // Poll period while connected
+    int searchMs;      // Poll period while searching for the relay
+    bool lockMemory;   // mlockall() the process and pre-fault the thread stack
+};
+
+// Opt-in replacement for the HUD's usbCommTimer_: polls the relay from its own SCHED_FIFO thread,
+// paced by clock_nanosleep() on absolute deadlines so one late wake-up does not shift all the following ones.
+// The thread owns its own driver; the GUI thread only reads the latest decoded state through a seqlock
+class TinklaRelayAcquisitionThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    TinklaRelayAcquisitionThread(const TinklaRelayRealtimeOptions &options, TinklaRelayShmPublisher *publisher, QObject *parent = nullptr);
+    ~TinklaRelayAcquisitionThread();  // Stops the thread
+
+    // Copies the last decoded state, false if nothing was decoded yet. decodedNs gets its TinklaRelayTrace::nowNs() time
+    bool latest(TinklaRelayState &state, quint64 *decodedNs = nullptr) const;
+    void stop();
+
+signals:
+    void connectionChanged(bool connected);
+
+protected:
+    void run() override;
+
+private:
+    TinklaRelayRealtimeOptions options_;
+    TinklaRelayShmPublisher *publisher_;
+    std::atomic<quint32> seq_;   // Odd while state_ is being written
+    TinklaRelayState state_;
+    quint64 decodedNs_;
+    std::atomic<bool> stopRequested_;
+
+    void setupRealtime();
+    void store(const TinklaRelayState &state, quint64 decodedNs);
+};
+
+#endif // TINKLARELAYACQUISITION_H
@@ -0,0 +1,151 @@
+// Includes
+#include <QApplication>
+#include <QTimer>
+#include <atomic>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tinklarelayalloccheck.h"
+#include "tinklarelayfaultinjection.h"
+#include "tinklarelayhud.h"
+
+#ifndef __GLIBC__
+#error "CONFIG+=alloccheck wraps the glibc allocator"
+#endif
+
+// Connecting, the first full redraw and Qt's rasterizer buffers growing to the largest gauge all allocate,
+// the check starts after them
+const int ALLOC_CHECK_WARMUP_MS = 3000;
+// Frames reported in detail, the rest are only counted
+const quint64 ALLOC_CHECK_REPORTED = 10;
+
+namespace {
+
+std::atomic<bool> armed(false);
+std::atomic<quint64> frameCount(0);
+std::atomic<quint64> failedCount(0);
+thread_local int frameDepth = 0;       // Plain TLS in the executable, reading it never allocates
+thread_local quint64 frameAllocations = 0;
+
+inline void countAllocation()
+{
+    if (frameDepth > 0) {
+        ++frameAllocations;
+    }
+}
+
+}
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+// operator new and Qt's containers end up here as well
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    countAllocation();
+    void *p = __libc_memalign(alignment, size);
+    if (p == nullptr) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+}
+
+void TinklaRelayAllocCheck::setArmed(bool on)
+{
+    armed.store(on, std::memory_order_relaxed);
+}
+
+quint64 TinklaRelayAllocCheck::frames()
+{
+    return frameCount.load(std::memory_order_relaxed);
+}
+
+quint64 TinklaRelayAllocCheck::failedFrames()
+{
+    return failedCount.load(std::memory_order_relaxed);
+}
+
+void TinklaRelayAllocCheck::frameBegin()
+{
+    if (frameDepth++ == 0) {
+        frameAllocations = 0;
+    }
+}
+
+void TinklaRelayAllocCheck::frameEnd(const char *name)
+{
+    if (--frameDepth > 0 || !armed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    frameCount.fetch_add(1, std::memory_order_relaxed);
+    if (frameAllocations > 0 && failedCount.fetch_add(1, std::memory_order_relaxed) < ALLOC_CHECK_REPORTED) {
+        fprintf(stderr, "Allocation check: %s allocated %llu times\n", name, static_cast<unsigned long long>(frameAllocations));
+    }
+}
+
+int tinklaRelayRunAllocCheck(int &argc, char **argv, int seconds)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");  // No display needed
+    }
+    //libusb allocates inside every synchronous transfer, so the relay is simulated
+    quint64 clockUs = 0;
+    TinklaRelayFaultInjectionBackend backend(&clockUs, 1);
+    backend.setDriveData(true);   // Every tick changes the numbers and the gauge, so every layer gets re-rendered
+    TinklaRelayUsbBackend::setCurrent(&backend);
+    {
+        QApplication app(argc, argv);
+        TinklaRelayHUD hud;
+        hud.show();
+        hud.drawHud();
+        hud.startSpinnerTimer(50);
+        hud.startUsbTimer(200);
+        QTimer::singleShot(ALLOC_CHECK_WARMUP_MS, []() { TinklaRelayAllocCheck::setArmed(true); });
+        QTimer::singleShot(ALLOC_CHECK_WARMUP_MS + seconds * 1000, &app, SLOT(quit()));
+        app.exec();
+        TinklaRelayAllocCheck::setArmed(false);
+    }
+    TinklaRelayUsbBackend::setCurrent(nullptr);
+    quint64 frames = TinklaRelayAllocCheck::frames();
+    quint64 failed = TinklaRelayAllocCheck::failedFrames();
+    printf("Allocation check: %llu frames, %llu allocated\n",
+           static_cast<unsigned long long>(frames), static_cast<unsigned long long>(failed));
+    return (frames == 0 || failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef TINKLARELAYALLOCCHECK_H
+#define TINKLARELAYALLOCCHECK_H
+
+// Includes
+#include <QtGlobal>
+#include "tinklarelaytrace.h"
+
+// Allocation tracking for the steady-state frame path. A CONFIG+=alloccheck build replaces malloc and friends
+// with counting wrappers; a TINKLA_ALLOC_FRAME scope marks one frame of work on the current thread, and once
+// the check is armed every frame that allocates is reported. In normal builds the scopes compile to nothing
+#ifdef TINKLA_ALLOC_CHECK
+#define TINKLA_ALLOC_FRAME(name) TinklaRelayAllocFrame TINKLA_TRACE_CONCAT(allocFrame_, __LINE__)(name)
+#else
+#define TINKLA_ALLOC_FRAME(name)
+#endif
+
+class TinklaRelayAllocCheck
+{
+public:
+    static void setArmed(bool armed);  // Frames before this are warm-up and not judged
+    static quint64 frames();           // Frames seen while armed
+    static quint64 failedFrames();     // Of those, the ones that allocated
+
+    // Used by TinklaRelayAllocFrame
+    static void frameBegin();
+    static void frameEnd(const char *name);
+};
+
+class TinklaRelayAllocFrame
+{
+public:
+    explicit TinklaRelayAllocFrame(const char *name) : name_(name) { TinklaRelayAllocCheck::frameBegin(); }
+    ~TinklaRelayAllocFrame() { TinklaRelayAllocCheck::frameEnd(name_); }
+private:
+    const char *name_;
+    TinklaRelayAllocFrame(const TinklaRelayAllocFrame &) = delete;
+    TinklaRelayAllocFrame &operator=(const TinklaRelayAllocFrame &) = delete;
+};
+
+// Runs the HUD against a healthy simulated relay whose speed, power, battery and ACC values change every frame,
+// arms the check after a warm-up and returns 1 if any GUI, driver or render worker frame allocated during the following seconds
+int tinklaRelayRunAllocCheck(int &argc, char **argv, int seconds);
+
+#endif // TINKLARELAYALLOCCHECK_H
@@ -0,0 +1,231 @@
+// Includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QPainter>
+#include <QSaveFile>
+#include <QVector>
+#include <cstring>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "tinklarelayassets.h"
+
+const char TinklaRelayAssets::MAGIC[8] = {'T', 'R', 'A', 'S', 'S', 'E', 'T', 'S'};
+
+// Pixel data alignment inside the blob, one cache line
+const quint64 ASSET_ALIGN = 64;
+
+TinklaRelayAssets::TinklaRelayAssets() :
+    data_(nullptr),
+    size_(0),
+    entries_(nullptr),
+    count_(0),
+    scale_(1.0)
+{
+}
+
+TinklaRelayAssets::~TinklaRelayAssets()
+{
+    if (data_ != nullptr) {
+        file_.unmap(const_cast<uchar *>(data_));
+    }
+}
+
+bool TinklaRelayAssets::open(const QString &path)
+{
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    size_ = file_.size();
+    if (size_ < static_cast<qint64>(sizeof(Header))) {
+        file_.close();
+        return false;
+    }
+    data_ = file_.map(0, size_);  // The file stays open for as long as the mapping is in use
+    if (data_ == nullptr) {
+        file_.close();
+        return false;
+    }
+    const Header *header = reinterpret_cast<const Header *>(data_);
+    quint64 tableEnd = sizeof(Header) + static_cast<quint64>(header->count) * sizeof(Entry);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION || tableEnd > static_cast<quint64>(size_)) {
+        file_.unmap(const_cast<uchar *>(data_));
+        file_.close();
+        data_ = nullptr;
+        return false;
+    }
+    entries_ = reinterpret_cast<const Entry *>(data_ + sizeof(Header));
+    count_ = header->count;
+    return true;
+}
+
+bool TinklaRelayAssets::openForScreen(const QSize &screen, qreal scale)
+{
+    scale_ = scale;
+    if (qFuzzyCompare(scale, 1.0)) {
+        return open(defaultPath());
+    }
+    //a cache older than the binary may hold different artwork
+    QString path = cachePath(screen);
+    QFileInfo cache(path);
+    if (!cache.exists() || cache.lastModified() < QFileInfo(QCoreApplication::applicationFilePath()).lastModified()) {
+        pack(path, scale);
+    }
+    return open(path);
+}
+
+bool TinklaRelayAssets::isMapped() const
+{
+    return data_ != nullptr;
+}
+
+QImage TinklaRelayAssets::image(const QString &name) const
+{
+    QByteArray latin1 = name.toLatin1();
+    for (quint32 i = 0; i < count_; ++i) {
+        const Entry &entry = entries_[i];
+        if (strncmp(entry.name, latin1.constData(), NAME_LEN) == 0) {
+            quint64 bytes = static_cast<quint64>(entry.bytesPerLine) * entry.height;
+            if (entry.offset + bytes > static_cast<quint64>(size_)) {
+                break;  // Truncated blob, decode instead
+            }
+            return QImage(data_ + entry.offset, static_cast<int>(entry.width), static_cast<int>(entry.height),
+                          static_cast<int>(entry.bytesPerLine), static_cast<QImage::Format>(entry.format));  // Read-only, wraps the mapping
+        }
+    }
+    return decode(name, scale_);
+}
+
+QImage TinklaRelayAssets::decode(const QString &name, qreal scale)
+{
+    QImage img(":/img/" + name);
+    if (!qFuzzyCompare(scale, 1.0) && !img.isNull()) {
+        img = img.scaled(qRound(img.width() * scale), qRound(img.height() * scale), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return img;
+}
+
+// The rvalue fromImage() lets the raster backend keep an image that is already in its format as it is,
+// so a pixmap of a mapped image points into the page cache instead of a private copy of the pixels
+QPixmap TinklaRelayAssets::pixmap(const QString &name) const
+{
+    return QPixmap::fromImage(image(name), Qt::NoFormatConversion);
+}
+
+QString TinklaRelayAssets::defaultPath()
+{
+    return QCoreApplication::applicationDirPath() + "/tinklaRelayHUD.assets";
+}
+
+QString TinklaRelayAssets::cachePath(const QSize &screen)
+{
+    return QCoreApplication::applicationDirPath() + QString("/tinklaRelayHUD-%1x%2.assets").arg(screen.width()).arg(screen.height());
+}
+
+QStringList TinklaRelayAssets::packedNames()
+{
+    return QStringList()
+        << "background.png"
+        << "speedLimitUS.png" << "speedLimitCA.png" << "speedLimitEU.png"
+        << "accAvailable.png" << "accEnabled.png"
+        << "apAvailable.png" << "apEnabled.png"
+        << "spinnerBkg.png" << "spinnerTrack.png"
+        << "settings.png";
+}
+
+// Resident and file-backed bytes from /proc/self/statm. File-backed pages can be dropped and reread, anonymous ones cannot
+static void residentBytes(quint64 *resident, quint64 *fileBacked)
+{
+    char buf[256];
+    unsigned long long size = 0, rss = 0, shared = 0;
+    *resident = 0;
+    *fileBacked = 0;
+    int fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+    buf[n > 0 ? n : 0] = '\0';
+    if (sscanf(buf, "%llu %llu %llu", &size, &rss, &shared) == 3) {
+        *resident = static_cast<quint64>(rss) * static_cast<quint64>(sysconf(_SC_PAGESIZE));
+        *fileBacked = static_cast<quint64>(shared) * static_cast<quint64>(sysconf(_SC_PAGESIZE));
+    }
+}
+
+int TinklaRelayAssets::measure(const QString &path)
+{
+    printf("source\tload ms\tresident KB after load\tanonymous KB after load\tresident KB after paint\tanonymous KB after paint\n");
+    for (int pass = 0; pass < 2; ++pass) {
+        TinklaRelayAssets assets;
+        if (pass == 0 && !assets.open(path)) {
+            fprintf(stderr, "Cannot open %s\n", path.toLocal8Bit().constData());
+            return 1;
+        }
+        quint64 rss0, file0, rss1, file1, rss2, file2;
+        residentBytes(&rss0, &file0);
+        QElapsedTimer timer;
+        timer.start();
+        QList<QPixmap> pixmaps;
+        foreach (const QString &name, packedNames()) {
+            pixmaps.append(pass == 0 ? assets.pixmap(name) : QPixmap::fromImage(decode(name, 1.0), Qt::NoFormatConversion));
+        }
+        qint64 loadNs = timer.nsecsElapsed();
+        residentBytes(&rss1, &file1);
+        //painting reads every pixel, so the mapped pages are resident after this
+        foreach (const QPixmap &pm, pixmaps) {
+            QImage scratch(pm.size(), QImage::Format_ARGB32_Premultiplied);
+            QPainter p(&scratch);
+            p.drawPixmap(0, 0, pm);
+        }
+        residentBytes(&rss2, &file2);
+        printf("%s\t%.2f\t%lld\t%lld\t%lld\t%lld\n", pass == 0 ? "blob" : "png", loadNs / 1e6,
+               static_cast<long long>(rss1 - rss0) / 1024, (static_cast<long long>(rss1 - file1) - static_cast<long long>(rss0 - file0)) / 1024,
+               static_cast<long long>(rss2 - rss0) / 1024, (static_cast<long long>(rss2 - file2) - static_cast<long long>(rss0 - file0)) / 1024);
+    }
+    return 0;
+}
+
+bool TinklaRelayAssets::pack(const QString &path, qreal scale)
+{
+    QStringList names = packedNames();
+    QList<QImage> images;
+    QVector<Entry> entries;
+    quint64 offset = sizeof(Header) + static_cast<quint64>(names.size()) * sizeof(Entry);
+    foreach (const QString &name, names) {
+        QImage img = decode(name, scale).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        if (img.isNull() || name.size() >= NAME_LEN) {
+            return false;
+        }
+        offset = (offset + ASSET_ALIGN - 1) & ~(ASSET_ALIGN - 1);
+        Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        strncpy(entry.name, name.toLatin1().constData(), NAME_LEN - 1);
+        entry.width = static_cast<quint32>(img.width());
+        entry.height = static_cast<quint32>(img.height());
+        entry.bytesPerLine = static_cast<quint32>(img.bytesPerLine());
+        entry.format = static_cast<quint32>(img.format());
+        entry.offset = offset;
+        offset += static_cast<quint64>(img.bytesPerLine()) * img.height();
+        entries.append(entry);
+        images.append(img);
+    }
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = static_cast<quint32>(entries.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.constData()), entries.size() * static_cast<int>(sizeof(Entry)));
+    for (int i = 0; i < images.size(); ++i) {
+        QByteArray padding(static_cast<int>(entries[i].offset - out.pos()), '\0');
+        out.write(padding);
+        out.write(reinterpret_cast<const char *>(images[i].constBits()), static_cast<qint64>(images[i].bytesPerLine()) * images[i].height());
+    }
+    return out.commit();
+}
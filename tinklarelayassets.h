@@ -0,0 +1,62 @@
+#ifndef TINKLARELAYASSETS_H
+#define TINKLARELAYASSETS_H
+
+// Includes
+#include <QFile>
+#include <QImage>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+// Pre-decoded image assets. At build time the PNGs from the resource file are converted to premultiplied
+// ARGB32 and written to one blob; at startup the blob is memory-mapped and each image is wrapped in a
+// QImage without decoding. Only the images that are actually asked for get paged in.
+// Screens other than the 800x480 design size get their own blob, scaled once on the first start at that resolution
+class TinklaRelayAssets
+{
+public:
+    static const char MAGIC[8];
+    static const quint32 VERSION = 1;
+    static const int NAME_LEN = 32;
+
+    TinklaRelayAssets();
+    ~TinklaRelayAssets();
+
+    bool open(const QString &path);  // Falls back to decoding the resources if the blob is missing or invalid
+    bool openForScreen(const QSize &screen, qreal scale);  // Default blob at scale 1, otherwise the per-resolution cache
+    bool isMapped() const;
+    QImage image(const QString &name) const;   // Name as aliased in tinklaRelayHUD.qrc, e.g. "background.png"
+    QPixmap pixmap(const QString &name) const;
+
+    static QString defaultPath();                   // Next to the executable
+    static QString cachePath(const QSize &screen);  // Same, with the resolution in the name
+    static QStringList packedNames();               // Images that go into the blob
+    static bool pack(const QString &path, qreal scale = 1.0);  // Build step (see the .pro file) and cache fill
+    static QImage decode(const QString &name, qreal scale);
+    // Loads and paints every packed image once from the blob at path, then once by decoding the PNGs,
+    // and prints the time and the memory each way took. Needs a QGuiApplication
+    static int measure(const QString &path);
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 count;
+    };
+    struct Entry {
+        char name[NAME_LEN];
+        quint32 width;
+        quint32 height;
+        quint32 bytesPerLine;
+        quint32 format;   // QImage::Format
+        quint64 offset;   // From the start of the file, 64-byte aligned
+    };
+    QFile file_;
+    const uchar *data_;
+    qint64 size_;
+    const Entry *entries_;
+    quint32 count_;
+    qreal scale_;
+};
+
+#endif // TINKLARELAYASSETS_H
@@ -0,0 +1,346 @@
+// Includes
+#include <string.h>
+#include "tinklarelaybatchdecoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TINKLA_BATCH_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TINKLA_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+#if defined(TINKLA_BATCH_NEON) && defined(__arm__)
+#include <sys/auxv.h>
+#endif
+
+// Bytes of the data message that are copied to a column as they are
+const int COPIED_BYTES[4] = {3, 4, 7, 9};
+
+// Frames are transposed this many at a time into a block of byte columns that stays in L1
+const size_t BLOCK_FRAMES = 32;
+
+struct ByteBlock {
+    alignas(32) uint8_t col[REL_DATA_SIZE][BLOCK_FRAMES];
+};
+
+void TinklaRelayColumnStore::resize(size_t frames)
+{
+    //24 flags and 7 byte values, then the power column
+    const int BYTE_COLUMNS = TinklaRelayColumns::NUM_FLAGS + 7;
+    bytes_.assign(frames * BYTE_COLUMNS, 0);
+    power_.assign(frames, 0);
+    uint8_t *p = bytes_.data();
+    for (int i = 0; i < TinklaRelayColumns::NUM_FLAGS; ++i, p += frames) {
+        columns_.flags[i] = p;
+    }
+    columns_.brightness = p; p += frames;
+    columns_.speed = p; p += frames;
+    columns_.accSpeed = p; p += frames;
+    columns_.speedLimit = p; p += frames;
+    columns_.accStatus = p; p += frames;
+    columns_.apAvailable = p; p += frames;
+    columns_.batteryLvl = p;
+    columns_.powerLvl = power_.data();
+}
+
+// Reference implementation, also handles the frames left over after the last full block
+static void decodeScalar(const uint8_t *frames, size_t stride, size_t begin, size_t end, const TinklaRelayColumns &out)
+{
+    for (size_t i = begin; i < end; ++i) {
+        const uint8_t *d = frames + i * stride;
+        for (int b = 0; b < 3; ++b) {
+            for (int k = 0; k < 8; ++k) {
+                out.flags[8 * b + k][i] = (d[b] >> k) & 1;
+            }
+        }
+        out.brightness[i] = d[3];
+        out.speed[i] = d[4];
+        out.powerLvl[i] = static_cast<int16_t>((d[5] << 8) | d[6]);
+        out.accSpeed[i] = d[7];
+        out.speedLimit[i] = static_cast<uint8_t>(5 * (d[8] & 0x1F));
+        out.accStatus[i] = (d[8] >> 5) & 0x03;
+        out.apAvailable[i] = (d[8] & REL_AP_AVAILABLE) ? 1 : 0;
+        out.batteryLvl[i] = d[9];
+    }
+}
+
+// The transposition done byte by byte: byte b of frame i + j goes to col[b][j]
+static inline void gatherScalar(const uint8_t *frames, size_t stride, size_t i, size_t n, ByteBlock &block)
+{
+    for (size_t j = 0; j < n; ++j) {
+        const uint8_t *d = frames + (i + j) * stride;
+        for (int b = 0; b < REL_DATA_SIZE; ++b) {
+            block.col[b][j] = d[b];
+        }
+    }
+}
+
+// The SIMD transpositions load 16 bytes per frame, frames i..i+15 are only safe to load that way
+// if the last of those loads ends within the input
+static inline bool wideLoadsFit(size_t stride, size_t count, size_t i)
+{
+    return (i + 15) * stride + 16 <= (count - 1) * stride + REL_DATA_SIZE;
+}
+
+static inline void copyThrough(const ByteBlock &block, size_t i, size_t n, const TinklaRelayColumns &out)
+{
+    uint8_t *copied[4] = {out.brightness, out.speed, out.accSpeed, out.batteryLvl};
+    for (int c = 0; c < 4; ++c) {
+        memcpy(copied[c] + i, block.col[COPIED_BYTES[c]], n);
+    }
+}
+
+#ifdef TINKLA_BATCH_X86
+// 16x16 byte transpose: four rounds of interleaving row k with row k + 8 turn rows into columns.
+// Row j is frame j, only the first REL_DATA_SIZE columns are kept
+__attribute__((target("sse2")))
+static inline void transposeSse2(const uint8_t *frames, size_t stride, uint8_t (&col)[REL_DATA_SIZE][BLOCK_FRAMES], int at)
+{
+    __m128i r[16];
+    __m128i t[16];
+    for (int j = 0; j < 16; ++j) {
+        r[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frames + j * stride));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int k = 0; k < 8; ++k) {
+            t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+        }
+        for (int j = 0; j < 16; ++j) {
+            r[j] = t[j];
+        }
+    }
+    for (int k = 0; k < REL_DATA_SIZE / 2; ++k) {
+        _mm_store_si128(reinterpret_cast<__m128i *>(col[2 * k] + at), _mm_unpacklo_epi8(r[k], r[k + 8]));
+        _mm_store_si128(reinterpret_cast<__m128i *>(col[2 * k + 1] + at), _mm_unpackhi_epi8(r[k], r[k + 8]));
+    }
+}
+
+__attribute__((target("sse2")))
+static void decodeSse2(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low5 = _mm_set1_epi8(0x1F);
+    const __m128i low2 = _mm_set1_epi8(0x03);
+    ByteBlock block;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        if (wideLoadsFit(stride, count, i)) {
+            transposeSse2(frames + i * stride, stride, block.col, 0);
+        } else {
+            gatherScalar(frames, stride, i, 16, block);
+        }
+        copyThrough(block, i, 16, out);
+        for (int b = 0; b < 3; ++b) {
+            __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(block.col[b]));
+            for (int k = 0; k < 8; ++k) {
+                //a 16-bit shift is fine, only bit 0 of each byte is kept
+                __m128i bit = _mm_and_si128(_mm_srl_epi16(v, _mm_cvtsi32_si128(k)), one);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out.flags[8 * b + k] + i), bit);
+            }
+        }
+        __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i *>(block.col[5]));
+        __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i *>(block.col[6]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.powerLvl + i), _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.powerLvl + i + 8), _mm_unpackhi_epi8(lo, hi));
+        __m128i v8 = _mm_load_si128(reinterpret_cast<const __m128i *>(block.col[8]));
+        __m128i limit = _mm_and_si128(v8, low5);
+        limit = _mm_add_epi8(_mm_slli_epi16(limit, 2), limit);  // 5 * x, at most 155 so no byte carries over
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.speedLimit + i), limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.accStatus + i), _mm_and_si128(_mm_srli_epi16(v8, 5), low2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.apAvailable + i), _mm_and_si128(_mm_srli_epi16(v8, 7), one));
+    }
+    decodeScalar(frames, stride, i, count, out);
+}
+
+// Same as transposeSse2, compiled for VEX so it does not mix with the 256-bit code around it
+__attribute__((target("avx2")))
+static inline void transposeAvx2(const uint8_t *frames, size_t stride, uint8_t (&col)[REL_DATA_SIZE][BLOCK_FRAMES], int at)
+{
+    __m128i r[16];
+    __m128i t[16];
+    for (int j = 0; j < 16; ++j) {
+        r[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frames + j * stride));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int k = 0; k < 8; ++k) {
+            t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+        }
+        for (int j = 0; j < 16; ++j) {
+            r[j] = t[j];
+        }
+    }
+    for (int k = 0; k < REL_DATA_SIZE / 2; ++k) {
+        _mm_store_si128(reinterpret_cast<__m128i *>(col[2 * k] + at), _mm_unpacklo_epi8(r[k], r[k + 8]));
+        _mm_store_si128(reinterpret_cast<__m128i *>(col[2 * k + 1] + at), _mm_unpackhi_epi8(r[k], r[k + 8]));
+    }
+}
+
+__attribute__((target("avx2")))
+static void decodeAvx2(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i low5 = _mm256_set1_epi8(0x1F);
+    const __m256i low2 = _mm256_set1_epi8(0x03);
+    ByteBlock block;
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        if (wideLoadsFit(stride, count, i + 16)) {
+            transposeAvx2(frames + i * stride, stride, block.col, 0);
+            transposeAvx2(frames + (i + 16) * stride, stride, block.col, 16);
+        } else {
+            gatherScalar(frames, stride, i, 32, block);
+        }
+        copyThrough(block, i, 32, out);
+        for (int b = 0; b < 3; ++b) {
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.col[b]));
+            for (int k = 0; k < 8; ++k) {
+                __m256i bit = _mm256_and_si256(_mm256_srl_epi16(v, _mm_cvtsi32_si128(k)), one);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.flags[8 * b + k] + i), bit);
+            }
+        }
+        //the unpacks work within 128-bit lanes, the permutes put the frames back in order
+        __m256i hi = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.col[5]));
+        __m256i lo = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.col[6]));
+        __m256i first = _mm256_unpacklo_epi8(lo, hi);
+        __m256i second = _mm256_unpackhi_epi8(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.powerLvl + i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.powerLvl + i + 16), _mm256_permute2x128_si256(first, second, 0x31));
+        __m256i v8 = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.col[8]));
+        __m256i limit = _mm256_and_si256(v8, low5);
+        limit = _mm256_add_epi8(_mm256_slli_epi16(limit, 2), limit);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.speedLimit + i), limit);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.accStatus + i), _mm256_and_si256(_mm256_srli_epi16(v8, 5), low2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.apAvailable + i), _mm256_and_si256(_mm256_srli_epi16(v8, 7), one));
+    }
+    decodeScalar(frames, stride, i, count, out);
+}
+#endif
+
+#ifdef TINKLA_BATCH_NEON
+// The transposeSse2 rounds, vzipq_u8 gives both interleaved halves at once
+static inline void transposeNeon(const uint8_t *frames, size_t stride, uint8_t (&col)[REL_DATA_SIZE][BLOCK_FRAMES])
+{
+    uint8x16_t r[16];
+    for (int j = 0; j < 16; ++j) {
+        r[j] = vld1q_u8(frames + j * stride);
+    }
+    for (int round = 0; round < 4; ++round) {
+        uint8x16_t t[16];
+        for (int k = 0; k < 8; ++k) {
+            uint8x16x2_t z = vzipq_u8(r[k], r[k + 8]);
+            t[2 * k] = z.val[0];
+            t[2 * k + 1] = z.val[1];
+        }
+        for (int j = 0; j < 16; ++j) {
+            r[j] = t[j];
+        }
+    }
+    for (int b = 0; b < REL_DATA_SIZE; ++b) {
+        vst1q_u8(col[b], r[b]);
+    }
+}
+
+static void decodeNeon(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    ByteBlock block;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        if (wideLoadsFit(stride, count, i)) {
+            transposeNeon(frames + i * stride, stride, block.col);
+        } else {
+            gatherScalar(frames, stride, i, 16, block);
+        }
+        copyThrough(block, i, 16, out);
+        for (int b = 0; b < 3; ++b) {
+            uint8x16_t v = vld1q_u8(block.col[b]);
+            for (int k = 0; k < 8; ++k) {
+                //a negative shift count shifts right
+                vst1q_u8(out.flags[8 * b + k] + i, vandq_u8(vshlq_u8(v, vdupq_n_s8(static_cast<int8_t>(-k))), one));
+            }
+        }
+        uint8x16x2_t power = vzipq_u8(vld1q_u8(block.col[6]), vld1q_u8(block.col[5]));  // Little-endian: low byte first
+        vst1q_s16(out.powerLvl + i, vreinterpretq_s16_u8(power.val[0]));
+        vst1q_s16(out.powerLvl + i + 8, vreinterpretq_s16_u8(power.val[1]));
+        uint8x16_t v8 = vld1q_u8(block.col[8]);
+        uint8x16_t limit = vandq_u8(v8, vdupq_n_u8(0x1F));
+        vst1q_u8(out.speedLimit + i, vaddq_u8(vshlq_n_u8(limit, 2), limit));
+        vst1q_u8(out.accStatus + i, vandq_u8(vshrq_n_u8(v8, 5), vdupq_n_u8(0x03)));
+        vst1q_u8(out.apAvailable + i, vshrq_n_u8(v8, 7));
+    }
+    decodeScalar(frames, stride, i, count, out);
+}
+#endif
+
+bool TinklaRelayBatchDecoder::supported(Isa isa)
+{
+    switch (isa) {
+        case ISA_SCALAR:
+            return true;
+#ifdef TINKLA_BATCH_X86
+        case ISA_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef TINKLA_BATCH_NEON
+        case ISA_NEON:
+#ifdef __arm__
+            //optional on 32-bit ARM cores
+            return (getauxval(AT_HWCAP) & HWCAP_ARM_NEON) != 0;
+#else
+            return true;
+#endif
+#endif
+        default:
+            return false;
+    }
+}
+
+TinklaRelayBatchDecoder::Isa TinklaRelayBatchDecoder::best()
+{
+    static const Isa isa = supported(ISA_AVX2) ? ISA_AVX2
+                         : supported(ISA_NEON) ? ISA_NEON
+                         : supported(ISA_SSE2) ? ISA_SSE2
+                         : ISA_SCALAR;
+    return isa;
+}
+
+const char *TinklaRelayBatchDecoder::name(Isa isa)
+{
+    switch (isa) {
+        case ISA_SCALAR: return "scalar";
+        case ISA_SSE2: return "sse2";
+        case ISA_AVX2: return "avx2";
+        case ISA_NEON: return "neon";
+        default: return "?";
+    }
+}
+
+void TinklaRelayBatchDecoder::decode(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out, Isa isa)
+{
+    if (!supported(isa)) {
+        isa = ISA_SCALAR;
+    }
+    switch (isa) {
+#ifdef TINKLA_BATCH_X86
+        case ISA_SSE2:
+            decodeSse2(frames, stride, count, out);
+            break;
+        case ISA_AVX2:
+            decodeAvx2(frames, stride, count, out);
+            break;
+#endif
+#ifdef TINKLA_BATCH_NEON
+        case ISA_NEON:
+            decodeNeon(frames, stride, count, out);
+            break;
+#endif
+        default:
+            decodeScalar(frames, stride, 0, count, out);
+            break;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef TINKLARELAYBATCHDECODER_H
+#define TINKLARELAYBATCHDECODER_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "tinklarelaystate.h"
+
+// Per-signal columns of a batch of data messages, entry i belongs to frame i. The arrays are owned by the caller
+// Every value is what TinklaRelayState::decode() gives for the same frame, with bools as 0 or 1
+struct TinklaRelayColumns {
+    static const int NUM_FLAGS = 24;   // The flag bits of bytes 0-2
+
+    uint8_t *flags[NUM_FLAGS];         // Flag 8 * byte + bit, see flagIndex()
+    uint8_t *brightness;
+    uint8_t *speed;
+    int16_t *powerLvl;
+    uint8_t *accSpeed;
+    uint8_t *speedLimit;
+    uint8_t *accStatus;
+    uint8_t *apAvailable;
+    uint8_t *batteryLvl;
+
+    // e.g. flagIndex(0, REL_CAR_ON), flagIndex(2, REL_LEFT_SIDE_BSM)
+    static int flagIndex(int byte, int mask) { return 8 * byte + __builtin_ctz(static_cast<unsigned>(mask)); }
+};
+
+// Owns the arrays of a TinklaRelayColumns
+class TinklaRelayColumnStore
+{
+public:
+    void resize(size_t frames);
+    const TinklaRelayColumns &columns() const { return columns_; }
+private:
+    std::vector<uint8_t> bytes_;
+    std::vector<int16_t> power_;
+    TinklaRelayColumns columns_;
+};
+
+// Decodes many data messages at once by transposing blocks of frames into per-signal columns and unpacking
+// whole columns with SIMD instructions, instead of writing every field of a TinklaRelayState per frame
+class TinklaRelayBatchDecoder
+{
+public:
+    enum Isa {
+        ISA_SCALAR = 0,
+        ISA_SSE2,
+        ISA_AVX2,
+        ISA_NEON,
+        NUM_ISAS
+    };
+    static bool supported(Isa isa);   // Compiled in and available on this CPU
+    static Isa best();
+    static const char *name(Isa isa);
+
+    // Frame i is the REL_DATA_SIZE bytes at frames + i * stride: REL_DATA_SIZE for packed messages,
+    // sizeof(TinklaRelayRecord) with frames pointing at the data of the first record of a recording
+    static void decode(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out, Isa isa);
+    static void decode(const uint8_t *frames, size_t stride, size_t count, const TinklaRelayColumns &out)
+    {
+        decode(frames, stride, count, out, best());
+    }
+};
+
+#endif // TINKLARELAYBATCHDECODER_H
@@ -0,0 +1,113 @@
+// Includes
+#include <QThread>
+#include "tinklarelayboot.h"
+#include "tinklarelaytrace.h"
+
+namespace {
+
+class BootThread : public QThread
+{
+public:
+    BootThread(const char *name, const TinklaRelayBoot::Work &work, QObject *parent) :
+        QThread(parent),
+        name_(name),
+        work_(work)
+    {
+    }
+protected:
+    void run() override
+    {
+        TinklaRelayTrace::setThreadName(name_);
+        TINKLA_TRACE_SPAN(name_);
+        work_();
+    }
+private:
+    const char *name_;
+    TinklaRelayBoot::Work work_;
+};
+
+}
+
+TinklaRelayBoot::TinklaRelayBoot(QObject *parent) :
+    QObject(parent)
+{
+}
+
+TinklaRelayBoot::~TinklaRelayBoot()
+{
+    for (int i = 0; i < tasks_.size(); ++i) {
+        if (tasks_[i].thread != nullptr) {
+            tasks_[i].thread->wait();
+        }
+    }
+}
+
+int TinklaRelayBoot::add(const char *name, const QList<int> &after, const Work &work, const Work &done)
+{
+    Task task;
+    task.name = name;
+    task.after = after;
+    task.work = work;
+    task.done = done;
+    task.thread = nullptr;
+    task.finished = false;
+    tasks_.append(task);
+    return tasks_.size() - 1;
+}
+
+void TinklaRelayBoot::start()
+{
+    startReady();
+}
+
+bool TinklaRelayBoot::isFinished(int task) const
+{
+    return task >= 0 && task < tasks_.size() && tasks_[task].finished;
+}
+
+bool TinklaRelayBoot::allFinished() const
+{
+    for (int i = 0; i < tasks_.size(); ++i) {
+        if (!tasks_[i].finished) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TinklaRelayBoot::startReady()
+{
+    for (int i = 0; i < tasks_.size(); ++i) {
+        Task &task = tasks_[i];
+        if (task.thread != nullptr) {
+            continue;
+        }
+        bool ready = true;
+        foreach (int dependency, task.after) {
+            ready = ready && isFinished(dependency);
+        }
+        if (ready) {
+            task.thread = new BootThread(task.name, task.work, this);
+            connect(task.thread, SIGNAL(finished()), this, SLOT(threadFinished()));
+            task.thread->start();
+        }
+    }
+}
+
+// Queued from the worker, so this and the continuation run on the GUI thread
+void TinklaRelayBoot::threadFinished()
+{
+    for (int i = 0; i < tasks_.size(); ++i) {
+        Task &task = tasks_[i];
+        if (task.thread != sender() || task.finished) {
+            continue;
+        }
+        task.finished = true;
+        if (task.done) {
+            TINKLA_TRACE_SPAN(task.name);
+            task.done();
+        }
+        startReady();
+        return;
+    }
+}
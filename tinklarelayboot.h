@@ -0,0 +1,48 @@
+#ifndef TINKLARELAYBOOT_H
+#define TINKLARELAYBOOT_H
+
+// Includes
+#include <QList>
+#include <QObject>
+#include <QVector>
+#include <functional>
+
+class QThread;
+
+// Startup work as a small dependency graph. Each task runs on its own thread as soon as the tasks it
+// depends on are done, then its continuation runs on the GUI thread. Worker code must stay off widgets
+// and QPixmap, it hands QImages and plain data to the continuation instead
+class TinklaRelayBoot : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void()> Work;
+
+    explicit TinklaRelayBoot(QObject *parent = nullptr);  // Construct on the GUI thread
+    ~TinklaRelayBoot();  // Waits for the tasks still running, their continuations are dropped
+
+    // name must be a string literal, it shows up in the trace
+    int add(const char *name, const QList<int> &after, const Work &work, const Work &done = Work());
+    void start();
+    bool isFinished(int task) const;
+    bool allFinished() const;
+
+private slots:
+    void threadFinished();
+
+private:
+    struct Task {
+        const char *name;
+        QList<int> after;
+        Work work;
+        Work done;
+        QThread *thread;
+        bool finished;
+    };
+    QVector<Task> tasks_;
+
+    void startReady();
+};
+
+#endif // TINKLARELAYBOOT_H
@@ -0,0 +1,106 @@
+// Includes
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tinklarelaybootprofile.h"
+
+std::atomic<uint64_t> TinklaRelayBootProfile::phaseNs_[NUM_PHASES] = {};
+
+static const char *const PHASE_NAMES[TinklaRelayBootProfile::NUM_PHASES] = {
+    "main", "application", "settings", "setupUi", "flipLayout", "assets", "spinner",
+    "firstPaint", "libusbInit", "deviceFound", "interfaceClaimed", "firstFrame", "liveData"
+};
+
+// Same clock as the process start time in /proc, so time before main() is counted too
+static uint64_t bootTimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Field 22 of /proc/self/stat, in clock ticks since boot. 0 if it cannot be read
+static uint64_t processStartNs()
+{
+    char buf[1024];
+    int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    //the command name in field 2 may contain spaces, count from the parenthesis that closes it
+    const char *p = strrchr(buf, ')');
+    for (int field = 2; p != nullptr && field < 22; ++field) {
+        p = strchr(p + 1, ' ');
+    }
+    if (p == nullptr) {
+        return 0;
+    }
+    unsigned long long ticks = strtoull(p + 1, nullptr, 10);
+    return static_cast<uint64_t>(ticks) * 1000000000ULL / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+}
+
+void TinklaRelayBootProfile::mark(Phase phase)
+{
+    if (phaseNs_[phase].load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+    uint64_t expected = 0;
+    phaseNs_[phase].compare_exchange_strong(expected, bootTimeNs(), std::memory_order_relaxed);
+}
+
+bool TinklaRelayBootProfile::reached(Phase phase)
+{
+    return phaseNs_[phase].load(std::memory_order_relaxed) != 0;
+}
+
+static void writeProfile(FILE *out, const std::atomic<uint64_t> *phaseNs)
+{
+    uint64_t startNs = processStartNs();
+    int order[TinklaRelayBootProfile::NUM_PHASES];
+    uint64_t ns[TinklaRelayBootProfile::NUM_PHASES];
+    for (int i = 0; i < TinklaRelayBootProfile::NUM_PHASES; ++i) {
+        order[i] = i;
+        ns[i] = phaseNs[i].load(std::memory_order_relaxed);
+    }
+    //unreached phases sort last, in enum order
+    std::stable_sort(order, order + TinklaRelayBootProfile::NUM_PHASES, [&ns](int a, int b) {
+        return (ns[a] - 1) < (ns[b] - 1);
+    });
+    fprintf(out, "# process started %.3f s after system boot\n", startNs / 1e9);
+    fprintf(out, "phase\tms since process start\tms since previous phase\n");
+    uint64_t previousNs = startNs;
+    for (int i = 0; i < TinklaRelayBootProfile::NUM_PHASES; ++i) {
+        int phase = order[i];
+        if (ns[phase] == 0) {
+            fprintf(out, "%s\t-\t-\n", PHASE_NAMES[phase]);
+            continue;
+        }
+        fprintf(out, "%s\t%.1f\t%.1f\n", PHASE_NAMES[phase], (ns[phase] - startNs) / 1e6, (ns[phase] - previousNs) / 1e6);
+        previousNs = ns[phase];
+    }
+}
+
+bool TinklaRelayBootProfile::write(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (out == nullptr) {
+        return false;
+    }
+    writeProfile(out, phaseNs_);
+    return fclose(out) == 0;
+}
+
+void TinklaRelayBootProfile::print()
+{
+    writeProfile(stderr, phaseNs_);
+}
@@ -0,0 +1,39 @@
+#ifndef TINKLARELAYBOOTPROFILE_H
+#define TINKLARELAYBOOTPROFILE_H
+
+// Includes
+#include <atomic>
+#include <stdint.h>
+
+// Startup phase timestamps, measured from the moment the kernel started the process.
+// Each phase keeps the first time it was reached; mark() is one clock read and one atomic, from any thread
+class TinklaRelayBootProfile
+{
+public:
+    enum Phase {
+        PHASE_MAIN = 0,           // main() entered, after dynamic linking and static initialization
+        PHASE_APPLICATION,        // QApplication created
+        PHASE_SETTINGS,           // tinklaRelaySettings.ini loaded
+        PHASE_SETUP_UI,
+        PHASE_FLIP_LAYOUT,
+        PHASE_ASSETS,             // Images mapped or scaled, on a boot worker
+        PHASE_SPINNER,            // Spinner frames rendered, on a boot worker
+        PHASE_FIRST_PAINT,
+        PHASE_LIBUSB_INIT,
+        PHASE_DEVICE_FOUND,
+        PHASE_INTERFACE_CLAIMED,
+        PHASE_FIRST_FRAME,        // First data message decoded
+        PHASE_LIVE_DATA,          // First HUD update drawn from it
+        NUM_PHASES
+    };
+
+    static void mark(Phase phase);
+    static bool reached(Phase phase);
+    // Phases in the order they were reached, then the missing ones. Also used to print at exit
+    static bool write(const char *path);
+    static void print();
+private:
+    static std::atomic<uint64_t> phaseNs_[NUM_PHASES];   // CLOCK_BOOTTIME, 0 until reached
+};
+
+#endif // TINKLARELAYBOOTPROFILE_H
@@ -0,0 +1,386 @@
+// Includes
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tinklarelaycolumnar.h"
+
+// Signal columns besides the timestamp. The power level spans two bytes and is kept as one 16-bit column
+const int NUM_COLUMNS = 9;
+const int POWER_COLUMN = 5;
+
+enum ColumnMode : uint8_t {
+    MODE_RLE_RAW = 0,    // Runs of equal values, for flag bytes that toggle
+    MODE_RLE_DELTA = 1   // Runs of equal differences, for values that ramp
+};
+
+static uint16_t columnValue(const uint8_t *data, int column)
+{
+    if (column < POWER_COLUMN) {
+        return data[column];
+    }
+    if (column == POWER_COLUMN) {
+        return static_cast<uint16_t>((data[5] << 8) | data[6]);
+    }
+    return data[column + 1];
+}
+
+static void setColumnValue(uint8_t *data, int column, uint16_t value)
+{
+    if (column < POWER_COLUMN) {
+        data[column] = static_cast<uint8_t>(value);
+    } else if (column == POWER_COLUMN) {
+        data[5] = static_cast<uint8_t>(value >> 8);
+        data[6] = static_cast<uint8_t>(value);
+    } else {
+        data[column + 1] = static_cast<uint8_t>(value);
+    }
+}
+
+static size_t putVarint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        if (out != nullptr) {
+            out[n] = static_cast<uint8_t>(value | 0x80);
+        }
+        value >>= 7;
+        n++;
+    }
+    if (out != nullptr) {
+        out[n] = static_cast<uint8_t>(value);
+    }
+    return n + 1;
+}
+
+static bool getVarint(const uint8_t *&in, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// Encodes one column as runs of (length, symbol). With out == nullptr it only measures
+static size_t encodeColumn(const TinklaRelayRecord *records, int count, int column, ColumnMode mode, uint8_t *out)
+{
+    size_t size = 0;
+    uint16_t previous = 0;
+    uint64_t runSymbol = 0;
+    uint64_t runLength = 0;
+    for (int i = 0; i < count; ++i) {
+        uint16_t value = columnValue(records[i].data, column);
+        uint64_t symbol = mode == MODE_RLE_RAW ? value : zigzag(static_cast<int16_t>(static_cast<uint16_t>(value - previous)));
+        previous = value;
+        if (runLength > 0 && symbol == runSymbol) {
+            runLength++;
+            continue;
+        }
+        if (runLength > 0) {
+            size += putVarint(out ? out + size : nullptr, runLength);
+            size += putVarint(out ? out + size : nullptr, runSymbol);
+        }
+        runSymbol = symbol;
+        runLength = 1;
+    }
+    if (runLength > 0) {
+        size += putVarint(out ? out + size : nullptr, runLength);
+        size += putVarint(out ? out + size : nullptr, runSymbol);
+    }
+    return size;
+}
+
+size_t TinklaRelayColumnar::encodeBlock(const TinklaRelayRecord *records, int count, uint8_t *out)
+{
+    size_t size = 0;
+    int64_t previousDelta = 0;
+    for (int i = 1; i < count; ++i) {
+        int64_t delta = static_cast<int64_t>(records[i].timestampUs - records[i - 1].timestampUs);
+        size += putVarint(out + size, zigzag(delta - previousDelta));
+        previousDelta = delta;
+    }
+    for (int column = 0; column < NUM_COLUMNS; ++column) {
+        size_t raw = encodeColumn(records, count, column, MODE_RLE_RAW, nullptr);
+        size_t delta = encodeColumn(records, count, column, MODE_RLE_DELTA, nullptr);
+        ColumnMode mode = delta < raw ? MODE_RLE_DELTA : MODE_RLE_RAW;
+        out[size++] = mode;
+        size += encodeColumn(records, count, column, mode, out + size);
+    }
+    return size;
+}
+
+bool TinklaRelayColumnar::decodeBlock(const uint8_t *payload, size_t payloadBytes, int count, uint64_t firstUs, TinklaRelayRecord *out)
+{
+    if (count <= 0 || count > BLOCK_RECORDS) {
+        return false;
+    }
+    const uint8_t *in = payload;
+    const uint8_t *end = payload + payloadBytes;
+    out[0].timestampUs = firstUs;
+    int64_t delta = 0;
+    for (int i = 1; i < count; ++i) {
+        uint64_t v;
+        if (!getVarint(in, end, v)) {
+            return false;
+        }
+        delta += unzigzag(v);
+        out[i].timestampUs = out[i - 1].timestampUs + static_cast<uint64_t>(delta);
+    }
+    for (int column = 0; column < NUM_COLUMNS; ++column) {
+        if (in >= end) {
+            return false;
+        }
+        uint8_t mode = *in++;
+        uint16_t previous = 0;
+        int i = 0;
+        while (i < count) {
+            uint64_t length, symbol;
+            if (!getVarint(in, end, length) || !getVarint(in, end, symbol) || length == 0 || length > static_cast<uint64_t>(count - i)) {
+                return false;
+            }
+            for (uint64_t r = 0; r < length; ++r, ++i) {
+                uint16_t value = mode == MODE_RLE_RAW ? static_cast<uint16_t>(symbol)
+                                                      : static_cast<uint16_t>(previous + unzigzag(symbol));
+                setColumnValue(out[i].data, column, value);
+                previous = value;
+            }
+        }
+    }
+    return in == end;
+}
+
+TinklaRelayColumnarWriter::TinklaRelayColumnarWriter(int fd) :
+    fd_(fd),
+    offset_(0),
+    count_(0),
+    failed_(false)
+{
+    writeAll(REL_COLUMNAR_MAGIC, REL_COLUMNAR_MAGIC_LEN);
+}
+
+bool TinklaRelayColumnarWriter::writeAll(const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0 && !failed_) {
+        ssize_t written = write(fd_, p, size);
+        if (written > 0) {
+            p += written;
+            size -= static_cast<size_t>(written);
+            offset_ += static_cast<uint64_t>(written);
+        } else if (written < 0 && errno != EINTR) {
+            failed_ = true;
+        }
+    }
+    return !failed_;
+}
+
+bool TinklaRelayColumnarWriter::append(uint64_t timestampUs, const uint8_t *data)
+{
+    block_[count_].timestampUs = timestampUs;
+    memcpy(block_[count_].data, data, REL_DATA_SIZE);
+    count_++;
+    if (count_ == TinklaRelayColumnar::BLOCK_RECORDS) {
+        return flushBlock();
+    }
+    return !failed_;
+}
+
+bool TinklaRelayColumnarWriter::flushBlock()
+{
+    if (count_ == 0 || failed_) {
+        count_ = 0;
+        return !failed_;
+    }
+    TinklaRelayColumnar::BlockHeader header;
+    header.magic = TinklaRelayColumnar::BLOCK_MAGIC;
+    header.records = static_cast<uint32_t>(count_);
+    header.firstUs = block_[0].timestampUs;
+    header.lastUs = block_[count_ - 1].timestampUs;
+    header.payloadBytes = static_cast<uint32_t>(TinklaRelayColumnar::encodeBlock(block_, count_, payload_));
+    TinklaRelayColumnar::IndexEntry entry;
+    entry.firstUs = header.firstUs;
+    entry.lastUs = header.lastUs;
+    entry.offset = offset_;
+    entry.records = header.records;
+    entry.reserved = 0;
+    index_.push_back(entry);
+    count_ = 0;
+    return writeAll(&header, sizeof(header)) && writeAll(payload_, header.payloadBytes);
+}
+
+bool TinklaRelayColumnarWriter::finish()
+{
+    if (!flushBlock()) {
+        return false;
+    }
+    TinklaRelayColumnar::Footer footer;
+    footer.indexOffset = offset_;
+    footer.blocks = static_cast<uint32_t>(index_.size());
+    footer.magic = TinklaRelayColumnar::FOOTER_MAGIC;
+    uint32_t indexMagic = TinklaRelayColumnar::INDEX_MAGIC;
+    return writeAll(&indexMagic, sizeof(indexMagic))
+        && writeAll(index_.data(), index_.size() * sizeof(TinklaRelayColumnar::IndexEntry))
+        && writeAll(&footer, sizeof(footer));
+}
+
+bool TinklaRelayColumnarWriter::failed() const
+{
+    return failed_;
+}
+
+uint64_t TinklaRelayColumnarWriter::pendingSinceUs() const
+{
+    return count_ > 0 ? block_[0].timestampUs : 0;
+}
+
+TinklaRelayColumnarReader::TinklaRelayColumnarReader() :
+    map_(nullptr),
+    size_(0),
+    hadIndex_(false)
+{
+}
+
+TinklaRelayColumnarReader::~TinklaRelayColumnarReader()
+{
+    if (map_ != nullptr) {
+        munmap(const_cast<uint8_t *>(map_), size_);
+    }
+}
+
+bool TinklaRelayColumnarReader::open(const char *path)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < REL_COLUMNAR_MAGIC_LEN) {
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    map_ = static_cast<const uint8_t *>(map);
+    if (memcmp(map_, REL_COLUMNAR_MAGIC, REL_COLUMNAR_MAGIC_LEN) != 0) {
+        return false;
+    }
+    hadIndex_ = loadIndex();
+    if (!hadIndex_) {
+        scanBlocks();
+    }
+    return true;
+}
+
+bool TinklaRelayColumnarReader::loadIndex()
+{
+    TinklaRelayColumnar::Footer footer;
+    if (size_ < REL_COLUMNAR_MAGIC_LEN + sizeof(footer)) {
+        return false;
+    }
+    memcpy(&footer, map_ + size_ - sizeof(footer), sizeof(footer));
+    uint64_t indexBytes = static_cast<uint64_t>(footer.blocks) * sizeof(TinklaRelayColumnar::IndexEntry);
+    if (footer.magic != TinklaRelayColumnar::FOOTER_MAGIC
+            || footer.indexOffset + sizeof(uint32_t) + indexBytes + sizeof(footer) != size_) {
+        return false;
+    }
+    uint32_t indexMagic;
+    memcpy(&indexMagic, map_ + footer.indexOffset, sizeof(indexMagic));
+    if (indexMagic != TinklaRelayColumnar::INDEX_MAGIC) {
+        return false;
+    }
+    index_.resize(footer.blocks);
+    memcpy(index_.data(), map_ + footer.indexOffset + sizeof(uint32_t), indexBytes);
+    return true;
+}
+
+void TinklaRelayColumnarReader::scanBlocks()
+{
+    index_.clear();
+    uint64_t offset = REL_COLUMNAR_MAGIC_LEN;
+    TinklaRelayColumnar::BlockHeader header;
+    while (offset + sizeof(header) <= size_) {
+        memcpy(&header, map_ + offset, sizeof(header));
+        if (header.magic != TinklaRelayColumnar::BLOCK_MAGIC || header.records == 0
+                || header.records > static_cast<uint32_t>(TinklaRelayColumnar::BLOCK_RECORDS)
+                || offset + sizeof(header) + header.payloadBytes > size_) {
+            break;  // Torn last block or the start of the index
+        }
+        TinklaRelayColumnar::IndexEntry entry;
+        entry.firstUs = header.firstUs;
+        entry.lastUs = header.lastUs;
+        entry.offset = offset;
+        entry.records = header.records;
+        entry.reserved = 0;
+        index_.push_back(entry);
+        offset += sizeof(header) + header.payloadBytes;
+    }
+}
+
+bool TinklaRelayColumnarReader::hadIndex() const
+{
+    return hadIndex_;
+}
+
+size_t TinklaRelayColumnarReader::blocks() const
+{
+    return index_.size();
+}
+
+const TinklaRelayColumnar::IndexEntry &TinklaRelayColumnarReader::block(size_t i) const
+{
+    return index_[i];
+}
+
+uint64_t TinklaRelayColumnarReader::records() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < index_.size(); ++i) {
+        total += index_[i].records;
+    }
+    return total;
+}
+
+size_t TinklaRelayColumnarReader::findBlock(uint64_t timestampUs) const
+{
+    std::vector<TinklaRelayColumnar::IndexEntry>::const_iterator it = std::lower_bound(index_.begin(), index_.end(), timestampUs,
+        [](const TinklaRelayColumnar::IndexEntry &entry, uint64_t t) { return entry.lastUs < t; });
+    return static_cast<size_t>(it - index_.begin());
+}
+
+bool TinklaRelayColumnarReader::readBlock(size_t i, TinklaRelayRecord *out) const
+{
+    const TinklaRelayColumnar::IndexEntry &entry = index_[i];
+    TinklaRelayColumnar::BlockHeader header;
+    if (entry.offset + sizeof(header) > size_) {
+        return false;
+    }
+    memcpy(&header, map_ + entry.offset, sizeof(header));
+    if (header.magic != TinklaRelayColumnar::BLOCK_MAGIC || header.records != entry.records
+            || entry.offset + sizeof(header) + header.payloadBytes > size_) {
+        return false;
+    }
+    return TinklaRelayColumnar::decodeBlock(map_ + entry.offset + sizeof(header), header.payloadBytes,
+                                            static_cast<int>(header.records), header.firstUs, out);
+}
@@ -0,0 +1,104 @@
+#ifndef TINKLARELAYCOLUMNAR_H
+#define TINKLARELAYCOLUMNAR_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "tinklarelayrecording.h"
+
+// Compressed recording: REL_COLUMNAR_MAGIC, then self-describing blocks of up to BLOCK_RECORDS frames,
+// then a block index and a fixed footer. Inside a block every signal is stored as its own column:
+// timestamps as delta-of-delta varints, the other signals run-length encoded, raw or as deltas, whichever is smaller.
+// A file cut short (power loss) has no index; readers rebuild it from the block headers and drop the torn block.
+// Kept free of Qt so offline tools can read it
+#define REL_COLUMNAR_MAGIC "TRCOL001"
+#define REL_COLUMNAR_MAGIC_LEN 8
+
+class TinklaRelayColumnar
+{
+public:
+    static const int BLOCK_RECORDS = 4096;
+    static const uint32_t BLOCK_MAGIC = 0x42435254u;   // "TRCB"
+    static const uint32_t INDEX_MAGIC = 0x49435254u;   // "TRCI"
+    static const uint32_t FOOTER_MAGIC = 0x45435254u;  // "TRCE"
+
+#pragma pack(push, 1)
+    struct BlockHeader {
+        uint32_t magic;
+        uint32_t records;
+        uint64_t firstUs;
+        uint64_t lastUs;
+        uint32_t payloadBytes;
+    };
+    struct IndexEntry {
+        uint64_t firstUs;
+        uint64_t lastUs;
+        uint64_t offset;   // Of the BlockHeader, from the start of the file
+        uint32_t records;
+        uint32_t reserved;
+    };
+    struct Footer {
+        uint64_t indexOffset;
+        uint32_t blocks;
+        uint32_t magic;
+    };
+#pragma pack(pop)
+
+    // Worst case payload of a full block, sizes the writer's only buffer
+    static const size_t MAX_PAYLOAD = BLOCK_RECORDS * (10 + 9 * 4) + 16;
+
+    static size_t encodeBlock(const TinklaRelayRecord *records, int count, uint8_t *out);
+    static bool decodeBlock(const uint8_t *payload, size_t payloadBytes, int count, uint64_t firstUs, TinklaRelayRecord *out);
+};
+
+// Streaming writer. Holds at most one block of frames plus the index (one entry per block)
+class TinklaRelayColumnarWriter
+{
+public:
+    explicit TinklaRelayColumnarWriter(int fd);
+
+    bool append(uint64_t timestampUs, const uint8_t *data);
+    bool flushBlock();   // Closes the current block early, e.g. so a quiet stream still reaches the disk
+    bool finish();       // Last block, index and footer. Nothing may be appended afterwards
+    bool failed() const;
+    uint64_t pendingSinceUs() const;  // Timestamp of the oldest frame not written yet, 0 if none
+private:
+    int fd_;
+    uint64_t offset_;
+    int count_;
+    bool failed_;
+    TinklaRelayRecord block_[TinklaRelayColumnar::BLOCK_RECORDS];
+    uint8_t payload_[TinklaRelayColumnar::MAX_PAYLOAD];
+    std::vector<TinklaRelayColumnar::IndexEntry> index_;
+
+    bool writeAll(const void *data, size_t size);
+};
+
+// Read-only mapping of a columnar recording
+class TinklaRelayColumnarReader
+{
+public:
+    TinklaRelayColumnarReader();
+    ~TinklaRelayColumnarReader();
+
+    bool open(const char *path);
+    bool hadIndex() const;   // False if the index had to be rebuilt from the block headers
+    size_t blocks() const;
+    const TinklaRelayColumnar::IndexEntry &block(size_t i) const;
+    uint64_t records() const;
+    size_t findBlock(uint64_t timestampUs) const;  // Binary search, the block holding or following timestampUs
+    bool readBlock(size_t i, TinklaRelayRecord *out) const;  // out holds block(i).records records
+private:
+    const uint8_t *map_;
+    size_t size_;
+    bool hadIndex_;
+    std::vector<TinklaRelayColumnar::IndexEntry> index_;
+
+    bool loadIndex();
+    void scanBlocks();
+    TinklaRelayColumnarReader(const TinklaRelayColumnarReader &) = delete;
+    TinklaRelayColumnarReader &operator=(const TinklaRelayColumnarReader &) = delete;
+};
+
+#endif // TINKLARELAYCOLUMNAR_H
@@ -0,0 +1,67 @@
+// Includes
+#include "tinklarelayconnection.h"
+#include "tinklarelaymetrics.h"
+
+TinklaRelayConnection::TinklaRelayConnection(TinklaRelayDriver &driver) :
+    driver_(driver),
+    connected_(false),
+    consecutiveFailures_(0)
+{
+}
+
+TinklaRelayConnection::Event TinklaRelayConnection::poll(bool *gotData)
+{
+    Event event = EVENT_NONE;
+    if (gotData != nullptr) {
+        *gotData = false;
+    }
+    if (driver_.disconnected()) {
+        if (connected_) {
+            //we were connected before
+            connected_ = false;
+            event = EVENT_DISCONNECTED;
+            TinklaRelayMetrics::instance().disconnects.inc();
+            reconnectTimer_.start();
+            driver_.close();
+        }
+        TinklaRelayDriver::Error error;
+        QStringList trDevs = TinklaRelayDriver::listDevices(error);
+        if (error.ok() && trDevs.length() > 0) {
+            //found device, whether it could be opened shows up in disconnected() on the next poll
+            driver_.open(trDevs[0]);
+        }
+    } else {
+        if (!connected_) {
+            connected_ = true;
+            consecutiveFailures_ = 0;
+            event = EVENT_CONNECTED;
+            if (reconnectTimer_.isValid()) {
+                TinklaRelayMetrics::instance().reconnects.inc();
+                TinklaRelayMetrics::instance().reconnectTime.observe(static_cast<quint64>(reconnectTimer_.nsecsElapsed() / 1000));
+                reconnectTimer_.invalidate();
+            }
+        }
+        if (driver_.getData()) {
+            driver_.processDataMessage();
+            consecutiveFailures_ = 0;
+            if (gotData != nullptr) {
+                *gotData = true;
+            }
+        } else if (++consecutiveFailures_ >= MAX_CONSECUTIVE_FAILURES) {
+            //timeouts and short reads never flag a disconnect on their own, so a relay that
+            //keeps failing would otherwise leave the HUD showing stale data forever
+            driver_.close();
+        }
+    }
+    return event;
+}
+
+bool TinklaRelayConnection::connected() const
+{
+    return connected_;
+}
+
+TinklaRelayDriver &TinklaRelayConnection::driver()
+{
+    return driver_;
+}
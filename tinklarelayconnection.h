@@ -0,0 +1,33 @@
+#ifndef TINKLARELAYCONNECTION_H
+#define TINKLARELAYCONNECTION_H
+
+// Includes
+#include <QElapsedTimer>
+#include "tinklarelaydriver.h"
+
+// Connection state machine formerly inlined in TinklaRelayHUD::usbComm()
+// Searches for the relay while disconnected, polls it while connected, and reports the transitions
+// It has no GUI dependencies so it can also be driven headless or against a scripted USB backend
+class TinklaRelayConnection
+{
+public:
+    enum Event {
+        EVENT_NONE,          // No transition on this poll
+        EVENT_CONNECTED,     // The relay is open and was polled for the first time
+        EVENT_DISCONNECTED   // The relay went away or kept failing and was closed
+    };
+    static const int MAX_CONSECUTIVE_FAILURES = 5;  // Failed polls tolerated before the relay is reopened
+
+    explicit TinklaRelayConnection(TinklaRelayDriver &driver);
+
+    Event poll(bool *gotData = nullptr);  // One tick, sets gotData when a new data message was decoded
+    bool connected() const;
+    TinklaRelayDriver &driver();
+private:
+    TinklaRelayDriver &driver_;
+    bool connected_;
+    int consecutiveFailures_;
+    QElapsedTimer reconnectTimer_;
+};
+
+#endif // TINKLARELAYCONNECTION_H
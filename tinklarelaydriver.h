@@ -6,50 +6,44 @@
 #include <QStringList>
 #include <QVector>
 #include <libusb-1.0/libusb.h>
-
-//First Byte After DATA
-#define REL_GEAR_IN_NEUTRAL 1
-#define REL_OPTION1_ON 2
-#define REL_OPTION2_ON 4
-#define REL_OPTION3_ON 8
-#define REL_OPTION4_ON 16
-#define REL_CAR_ON 32
-#define REL_GEAR_IN_REVERSE 64
-#define REL_GEAR_IN_FORWARD 128
-//Second Byte After DATA
-#define REL_BRAKE_HOLD 1
-#define REL_LEFT_TURN_SIGNAL 2
-#define REL_RIGHT_TURN_SIGNAL 4
-#define REL_BRAKE_PRESSED 8
-#define REL_HIGHBEAMS_ON 16
-#define REL_LIGHT_ON 32
-#define REL_BELOW_20MPH 64
-#define REL_USE_IMPERIAL_FOR_SPEED 128
-//Third Byte After DATA
-#define REL_TPMS_ALERT_ON 1
-#define REL_LEFT_STEERING_ANGLE_ABOVE_45DEG 2
-#define REL_RIGHT_STEERING_ANGLE_ABOVE_45DEG 4
-#define REL_AP_ON 8
-#define REL_CAR_CHARGING 16
-#define REL_LEFT_SIDE_BSM 32
-#define REL_RIGHT_SIDE_BSM 64
-#define REL_TACC_ONLY_ACTIVE 128
-//Eighth Byte adter DATA
-#define REL_AP_AVAILABLE 128
+#include "tinklarelaystate.h"
 
 //CONTROL READ VALUES
 #define GET_TINKLA_RELAY_DATA 0xFE
-#define GET_TINKLA_RELAY_DATA_SIZE 0x0a
+#define GET_TINKLA_RELAY_DATA_SIZE REL_DATA_SIZE
 
 class TinklaRelayDriver
 {
+public:
+    // Outcome of a transfer or of a libusb helper call. Plain data, so reporting a failure never allocates
+    enum ErrorCode : quint8 {
+        ERRC_NONE = 0,             // No error
+        ERRC_NOT_OPEN,             // Transfer attempted while the device is not open (program logic error)
+        ERRC_CONTROL_TRANSFER,     // Control transfer failed or transferred fewer bytes than requested
+        ERRC_BULK_OUT,             // Bulk OUT transfer failed or was short
+        ERRC_BULK_IN,              // Bulk IN transfer failed or was short
+        ERRC_INIT,                 // libusb could not be initialized
+        ERRC_DEVICE_LIST           // libusb could not retrieve the device list
+    };
+    struct Error {
+        ErrorCode code;
+        int usbResult;   // libusb return value: a negative libusb_error, or the byte count of a short transfer
+        quint8 arg1;     // bmRequestType for control transfers, endpoint address for bulk transfers
+        quint8 arg2;     // bRequest for control transfers
+
+        bool ok() const { return code == ERRC_NONE; }
+    };
+    static Error noError();
+    static QString errorString(const Error &error);  // Builds the translated message, only call this when logging
+
 private:
     libusb_context *context_;
     libusb_device_handle *handle_;
     bool disconnected_, kernelWasAttached_;
+    Error lastError_;
 
-    QString getDescGeneric(quint8 command, int &errcnt, QString &errstr);
-    void writeDescGeneric(const QString &descriptor, quint8 command, int &errcnt, QString &errstr);
+    QString getDescGeneric(quint8 command, Error &error);
+    void writeDescGeneric(const QString &descriptor, quint8 command, Error &error);
 public:
     // Class definitions
     static const quint16 VID = 0xbbaa;     // Default USB vendor ID
@@ -114,47 +108,19 @@ public:
     bool isOpen() const;
     int open(const QString &serial);
 
-    void bulkTransfer(quint8 endpointAddr, unsigned char *data, int length, int *transferred, int &errcnt, QString &errstr);
+    Error bulkTransfer(quint8 endpointAddr, unsigned char *data, int length, int *transferred);
     void close();
-    void controlTransfer(quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, int &errcnt, QString &errstr);
-    static QStringList listDevices(int &errcnt, QString &errstr);
+    Error controlTransfer(quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength);
+    static QStringList listDevices(Error &error);
     void processDataMessage();
     bool getData();
+    const Error &lastError() const;  // Error of the last getData(), ERRC_NONE if it succeeded
+
+    const uint8_t *rawData() const;  // The last data message as received, GET_TINKLA_RELAY_DATA_SIZE bytes
 
-    //VALUES
-    volatile bool rel_option1_on = false;
-    volatile bool rel_option2_on = false;
-    volatile bool rel_option3_on = false;
-    volatile bool rel_option4_on = false;
-    volatile bool rel_car_on = false;
-    volatile bool rel_gear_in_reverse = false;
-    volatile bool rel_gear_in_forward = false;
-    volatile bool rel_gear_in_neutral = false;
-    volatile bool rel_left_turn_signal = false;
-    volatile bool rel_right_turn_signal = false;
-    volatile bool rel_brake_pressed = false;
-    volatile bool rel_highbeams_on = false;
-    volatile bool rel_light_on = false;
-    volatile bool rel_below_20mph = false; //BELOW 20 MPH
-    volatile bool rel_left_steering_above_45deg = false; //MORE THAN 45 DEG
-    volatile bool rel_right_steering_above_45deg = false; //MORE THAN 45 DEG
-    volatile bool rel_AP_on = false; //start with true if only Veh can is connected
-    volatile bool rel_car_charging = false;
-    volatile bool rel_left_side_bsm = false;
-    volatile bool rel_right_side_bsm = false;
-    volatile bool rel_tacc_only_active = false;
-    volatile bool rel_use_imperial = false; //imperial vs metric for speed
-    volatile bool rel_brake_hold_on = false;
-    volatile bool rel_tpms_alert_on = false;
-    volatile uint8_t rel_brightness = 100; // start brightness value
-    volatile uint8_t rel_speed = 0; //starting speed, speed is in the UoM set on car
-    volatile int16_t rel_power_lvl = 0;
-    volatile bool rel_AP_available = false;
-    volatile uint8_t rel_acc_status = 0;
-    volatile uint8_t rel_acc_speed = 0;
-    volatile uint8_t rel_speed_limit = 0;
+    //VALUES, decoded from the last data message by processDataMessage()
+    TinklaRelayState state;
     bool tinklaRelayInitialized = false;
-    volatile uint8_t rel_battery_lvl = 0;
 };
 
 #endif // TINKLARELAYDRIVER_H
@@ -0,0 +1,167 @@
+// Includes
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tinklarelayenergygauge.h"
+
+// Range the check compares the marker positions over, beyond the largest HUD gauge and a full turn either way
+const int CHECK_MAX_RADIUS = 1500;
+const int CHECK_MAX_DEGREES = 400;
+
+namespace {
+
+// Piecewise compression of the power gauge, each segment above the first counts half as much as the previous one
+constexpr int POS_SCALE[4] = {40, 80, 160, 320};
+constexpr int NEG_SCALE[2] = {-30, -60};
+
+constexpr int compress(int pwrUsed)
+{
+    int value = 0;
+    if (pwrUsed > 0) {
+        value = pwrUsed < POS_SCALE[0] ? pwrUsed : POS_SCALE[0];
+        for (int i = 0; i < 3; ++i) {
+            if (pwrUsed > POS_SCALE[i]) {
+                int top = pwrUsed < POS_SCALE[i + 1] ? pwrUsed : POS_SCALE[i + 1];
+                value += (top - POS_SCALE[i]) / (2 << i);
+            }
+        }
+    }
+    if (pwrUsed < 0) {
+        value = pwrUsed > NEG_SCALE[0] ? pwrUsed : NEG_SCALE[0];
+        if (pwrUsed < NEG_SCALE[0]) {
+            int bottom = pwrUsed > NEG_SCALE[1] ? pwrUsed : NEG_SCALE[1];
+            value += (bottom - NEG_SCALE[0]) / 2;   //truncates toward zero like the (int) cast it replaces
+        }
+        value = value * POS_SCALE[0] / -NEG_SCALE[0];
+    }
+    return value;
+}
+
+struct GaugeTable {
+    int8_t value[TinklaRelayEnergyGauge::POWER_MAX - TinklaRelayEnergyGauge::POWER_MIN + 1];
+};
+
+constexpr GaugeTable makeGaugeTable()
+{
+    GaugeTable table = {};
+    for (int p = TinklaRelayEnergyGauge::POWER_MIN; p <= TinklaRelayEnergyGauge::POWER_MAX; ++p) {
+        table.value[p - TinklaRelayEnergyGauge::POWER_MIN] = static_cast<int8_t>(compress(p));
+    }
+    return table;
+}
+
+// Taylor series after reducing to [-180, 180] degrees, the terms are below 1e-20 by the last one
+constexpr double cosDeg(int deg)
+{
+    while (deg > 180) {
+        deg -= 360;
+    }
+    while (deg < -180) {
+        deg += 360;
+    }
+    const double x = deg * 3.14159265358979323846 / 180;
+    double term = 1;
+    double sum = 1;
+    for (int n = 1; n <= 30; ++n) {
+        term = -term * x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+struct TrigTable {
+    int16_t cos[360];
+};
+
+constexpr TrigTable makeTrigTable()
+{
+    TrigTable table = {};
+    for (int deg = 0; deg < 360; ++deg) {
+        double v = cosDeg(deg) * (1 << TinklaRelayEnergyGauge::TRIG_SHIFT);
+        table.cos[deg] = static_cast<int16_t>(v >= 0 ? static_cast<int>(v + 0.5) : -static_cast<int>(-v + 0.5));
+    }
+    return table;
+}
+
+constexpr GaugeTable GAUGE = makeGaugeTable();
+constexpr TrigTable TRIG = makeTrigTable();
+
+static_assert(GAUGE.value[0] == -60 && GAUGE.value[60] == 0 && GAUGE.value[60 + 40] == 40
+              && GAUGE.value[60 + 320] == 100, "gauge scale end points");
+static_assert(TRIG.cos[0] == 1 << TinklaRelayEnergyGauge::TRIG_SHIFT && TRIG.cos[90] == 0
+              && TRIG.cos[180] == -(1 << TinklaRelayEnergyGauge::TRIG_SHIFT) && TRIG.cos[60] == 8192, "trig table");
+
+}
+
+int TinklaRelayEnergyGauge::gaugeValue(int pwrUsed)
+{
+    if (pwrUsed < POWER_MIN) {
+        pwrUsed = POWER_MIN;
+    } else if (pwrUsed > POWER_MAX) {
+        pwrUsed = POWER_MAX;
+    }
+    return GAUGE.value[pwrUsed - POWER_MIN];
+}
+
+int TinklaRelayEnergyGauge::cosQ(int deg)
+{
+    deg %= 360;
+    if (deg < 0) {
+        deg += 360;
+    }
+    return TRIG.cos[deg];
+}
+
+// The floating point version the tables replaced, kept verbatim as the reference for the check
+static int referenceGaugeValue(int pwrUsed)
+{
+    const int posScale[4] = {40,80,160,320};
+    const int negScale[2] = {-30,-60};
+    int engScaled = 0;
+    if (pwrUsed > 0) {
+        engScaled = std::min(posScale[0],pwrUsed);
+        for (int i=0;i<3;i++) {
+           if (pwrUsed > posScale[i]) {
+             engScaled += (int)((std::min(posScale[i+1],pwrUsed) - posScale[i])/pow(2,i+1));
+           }
+        }
+    }
+    if (pwrUsed < 0) {
+        engScaled = std::max(negScale[0],pwrUsed);
+        for (int i=0;i<1;i++) {
+           if (pwrUsed < negScale[i]) {
+             engScaled += (int)((std::max(negScale[i+1],pwrUsed) - negScale[i])/pow(2,i+1));
+           }
+        }
+        engScaled = (int)(engScaled * posScale[0] / std::abs(negScale[0]));
+    }
+    return engScaled;
+}
+
+int tinklaRelayCheckEnergyGauge()
+{
+    int worstGauge = 0;
+    for (int p = -32768; p <= 32767; ++p) {
+        worstGauge = std::max(worstGauge, std::abs(TinklaRelayEnergyGauge::gaugeValue(p) - referenceGaugeValue(p)));
+    }
+    int worstMarker = 0;
+    long exact = 0;
+    long total = 0;
+    for (int r = 1; r <= CHECK_MAX_RADIUS; ++r) {
+        for (int deg = -CHECK_MAX_DEGREES; deg <= CHECK_MAX_DEGREES; ++deg) {
+            int x = (int)(r * cos(deg * 3.14159 / 180));
+            int y = (int)(r * sin(deg * 3.14159 / 180));
+            int error = std::max(std::abs(TinklaRelayEnergyGauge::projectX(r, deg) - x),
+                                 std::abs(TinklaRelayEnergyGauge::projectY(r, deg) - y));
+            worstMarker = std::max(worstMarker, error);
+            exact += error == 0 ? 1 : 0;
+            total++;
+        }
+    }
+    printf("Energy gauge check: gaugeValue worst difference %d over all int16 power values\n", worstGauge);
+    printf("Energy gauge check: projectX/projectY worst difference %d px over radius 1-%d and %d to %d degrees, %.1f%% exact\n",
+           worstMarker, CHECK_MAX_RADIUS, -CHECK_MAX_DEGREES, CHECK_MAX_DEGREES, 100.0 * exact / total);
+    return (worstGauge > 1 || worstMarker > 1) ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef TINKLARELAYENERGYGAUGE_H
+#define TINKLARELAYENERGYGAUGE_H
+
+// Integer mapping from power and battery to gauge angles and marker positions.
+// The tables behind it are built by the compiler, drawing the gauge needs no floating point math
+class TinklaRelayEnergyGauge
+{
+public:
+    static const int POWER_MIN = -60;    // The gauge value does not change below or above these
+    static const int POWER_MAX = 320;
+    static const int TRIG_SHIFT = 14;    // cosQ()/sinQ() are scaled by 1 << TRIG_SHIFT
+
+    // Power after the piecewise compression of the gauge scale, negative power is stretched to the positive scale
+    static int gaugeValue(int pwrUsed);
+    // Angles are whole degrees, any value
+    static int cosQ(int deg);
+    static int sinQ(int deg) { return cosQ(deg - 90); }
+    // radius * cos(deg) truncated toward zero, like the (int) cast of the floating point version
+    static int projectX(int radius, int deg) { return radius * cosQ(deg) / (1 << TRIG_SHIFT); }
+    static int projectY(int radius, int deg) { return radius * sinQ(deg) / (1 << TRIG_SHIFT); }
+};
+
+// Compares the tables with the floating point code they replaced: gaugeValue() over every int16 power and
+// projectX()/projectY() over radii and angles past anything the HUD draws. Prints the worst differences
+// and returns 1 if any is above 1
+int tinklaRelayCheckEnergyGauge();
+
+#endif // TINKLARELAYENERGYGAUGE_H
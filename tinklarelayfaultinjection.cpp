@@ -0,0 +1,391 @@
+// Includes
+#include <QElapsedTimer>
+#include <QVector>
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+#include "tinklarelayfaultinjection.h"
+#include "tinklarelayconnection.h"
+#include "tinklarelaydriver.h"
+#include "tinklarelayscreenmode.h"
+
+// Simulated latencies in microseconds, roughly what a Pi 3 sees with the relay on a USB 2.0 port
+const quint64 SIM_INIT_US = 2000;
+const quint64 SIM_LIST_US = 4000;
+const quint64 SIM_OPEN_US = 3000;
+const quint64 SIM_CLAIM_US = 500;
+const quint64 SIM_TRANSFER_US = 300;
+
+// First fake pointer handed out, anything non-null works since nothing ever dereferences them
+const quintptr SIM_FIRST_TOKEN = 0x1000;
+
+// One in this many faults also restarts the HUD with a warm start, as a crash or the settings dialog would while the relay misbehaves
+const int SIM_RESTART_ONE_IN = 4;
+
+const char *TinklaRelayFaultInjectionBackend::faultName(Fault fault)
+{
+    switch (fault) {
+        case FAULT_NONE: return "none";
+        case FAULT_UNPLUGGED: return "unplugged";
+        case FAULT_IO: return "io";
+        case FAULT_PIPE: return "pipe";
+        case FAULT_TIMEOUT: return "timeout";
+        case FAULT_SHORT_READ: return "short-read";
+        case FAULT_BUSY: return "busy";
+        case FAULT_FLAPPING: return "flapping";
+        default: return "?";
+    }
+}
+
+TinklaRelayFaultInjectionBackend::TinklaRelayFaultInjectionBackend(quint64 *clockUs, quint32 seed) :
+    clockUs_(clockUs),
+    rng_(seed),
+    fault_(FAULT_NONE),
+    present_(true),
+    nextFlapUs_(0),
+    generation_(0),
+    nextToken_(SIM_FIRST_TOKEN),
+    misuse_(0),
+    frameCounter_(0),
+    driveData_(false),
+    driveStep_(0)
+{
+}
+
+void TinklaRelayFaultInjectionBackend::setFault(Fault fault)
+{
+    fault_ = fault;
+    if (fault == FAULT_BUSY) {
+        ++generation_;  // A brownout resets the relay, so whatever handle we hold is dead
+    }
+    if (fault == FAULT_FLAPPING) {
+        nextFlapUs_ = *clockUs_;
+    }
+    setPresent(fault != FAULT_UNPLUGGED);
+}
+
+void TinklaRelayFaultInjectionBackend::setDriveData(bool drive)
+{
+    driveData_ = drive;
+}
+
+TinklaRelayFaultInjectionBackend::Fault TinklaRelayFaultInjectionBackend::fault() const
+{
+    return fault_;
+}
+
+int TinklaRelayFaultInjectionBackend::liveContexts() const
+{
+    return contexts_.size();
+}
+
+int TinklaRelayFaultInjectionBackend::liveHandles() const
+{
+    return handles_.size();
+}
+
+int TinklaRelayFaultInjectionBackend::misuseCount() const
+{
+    return misuse_;
+}
+
+void TinklaRelayFaultInjectionBackend::advance(quint64 us)
+{
+    *clockUs_ += us;
+}
+
+void TinklaRelayFaultInjectionBackend::setPresent(bool present)
+{
+    if (present_ && !present) {
+        ++generation_;
+    }
+    present_ = present;
+}
+
+void TinklaRelayFaultInjectionBackend::updateFlapping()
+{
+    if (fault_ == FAULT_FLAPPING && *clockUs_ >= nextFlapUs_) {
+        setPresent(!present_);
+        nextFlapUs_ = *clockUs_ + std::uniform_int_distribution<quint64>(50000, 800000)(rng_);
+    }
+}
+
+int TinklaRelayFaultInjectionBackend::init(libusb_context **context)
+{
+    advance(SIM_INIT_US);
+    quintptr token = nextToken_++;
+    contexts_.insert(token, true);
+    *context = reinterpret_cast<libusb_context *>(token);
+    return 0;
+}
+
+void TinklaRelayFaultInjectionBackend::exit(libusb_context *context)
+{
+    if (contexts_.remove(reinterpret_cast<quintptr>(context)) == 0) {
+        ++misuse_;
+    }
+}
+
+ssize_t TinklaRelayFaultInjectionBackend::findSerials(libusb_context *context, quint16 vid, quint16 pid, QStringList &serials)
+{
+    Q_UNUSED(vid);
+    Q_UNUSED(pid);
+    advance(SIM_LIST_US);
+    updateFlapping();
+    if (!contexts_.contains(reinterpret_cast<quintptr>(context))) {
+        ++misuse_;
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    if (present_) {
+        serials += QStringLiteral("SIM0001");
+    }
+    return present_ ? 1 : 0;
+}
+
+libusb_device_handle *TinklaRelayFaultInjectionBackend::openDevice(libusb_context *context, quint16 vid, quint16 pid, const QString &serial)
+{
+    Q_UNUSED(vid);
+    Q_UNUSED(pid);
+    Q_UNUSED(serial);
+    advance(SIM_OPEN_US);
+    updateFlapping();
+    if (!contexts_.contains(reinterpret_cast<quintptr>(context))) {
+        ++misuse_;
+        return nullptr;
+    }
+    if (!present_) {
+        return nullptr;
+    }
+    quintptr token = nextToken_++;
+    handles_.insert(token, generation_);
+    return reinterpret_cast<libusb_device_handle *>(token);
+}
+
+void TinklaRelayFaultInjectionBackend::close(libusb_device_handle *handle)
+{
+    if (handles_.remove(reinterpret_cast<quintptr>(handle)) == 0) {
+        ++misuse_;
+    }
+}
+
+int TinklaRelayFaultInjectionBackend::kernelDriverActive(libusb_device_handle *handle, int interface)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(interface);
+    return 0;
+}
+
+int TinklaRelayFaultInjectionBackend::detachKernelDriver(libusb_device_handle *handle, int interface)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(interface);
+    return 0;
+}
+
+int TinklaRelayFaultInjectionBackend::attachKernelDriver(libusb_device_handle *handle, int interface)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(interface);
+    return 0;
+}
+
+int TinklaRelayFaultInjectionBackend::claimInterface(libusb_device_handle *handle, int interface)
+{
+    Q_UNUSED(interface);
+    advance(SIM_CLAIM_US);
+    updateFlapping();
+    if (!handles_.contains(reinterpret_cast<quintptr>(handle))) {
+        ++misuse_;
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    if (handles_.value(reinterpret_cast<quintptr>(handle)) != generation_ || !present_) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return fault_ == FAULT_BUSY ? LIBUSB_ERROR_BUSY : 0;
+}
+
+int TinklaRelayFaultInjectionBackend::releaseInterface(libusb_device_handle *handle, int interface)
+{
+    Q_UNUSED(interface);
+    if (!handles_.contains(reinterpret_cast<quintptr>(handle))) {
+        ++misuse_;
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    return 0;
+}
+
+// Shared failure logic of both transfer types, returns the byte count on success
+int TinklaRelayFaultInjectionBackend::transferResult(libusb_device_handle *handle, int length, unsigned int timeout)
+{
+    advance(SIM_TRANSFER_US);
+    updateFlapping();
+    if (!handles_.contains(reinterpret_cast<quintptr>(handle))) {
+        ++misuse_;
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    if (handles_.value(reinterpret_cast<quintptr>(handle)) != generation_ || !present_) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    switch (fault_) {
+        case FAULT_IO:
+            return LIBUSB_ERROR_IO;
+        case FAULT_PIPE:
+            return LIBUSB_ERROR_PIPE;
+        case FAULT_TIMEOUT:
+            advance(static_cast<quint64>(timeout) * 1000);
+            return LIBUSB_ERROR_TIMEOUT;
+        case FAULT_SHORT_READ:
+            return length / 2;
+        default:
+            return length;
+    }
+}
+
+int TinklaRelayFaultInjectionBackend::controlTransfer(libusb_device_handle *handle, quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, unsigned int timeout)
+{
+    Q_UNUSED(bmRequestType);
+    Q_UNUSED(bRequest);
+    Q_UNUSED(wValue);
+    Q_UNUSED(wIndex);
+    int result = transferResult(handle, wLength, timeout);
+    for (int i = 0; i < result; ++i) {
+        data[i] = 0;
+    }
+    if (result >= 5) {
+        data[0] = REL_CAR_ON | REL_GEAR_IN_FORWARD;
+        data[4] = frameCounter_++;  // Changing speed, so every good frame is distinguishable
+    }
+    if (driveData_ && result >= 10) {
+        //steps chosen so the values drift against each other instead of repeating in lockstep
+        int power = -80 + static_cast<int>(driveStep_ * 53 % 440);  // Past both ends of the gauge scale
+        data[5] = static_cast<quint8>((power >> 8) & 0xFF);
+        data[6] = static_cast<quint8>(power & 0xFF);
+        data[7] = static_cast<quint8>(30 + driveStep_ % 120);       // ACC speed
+        data[8] = static_cast<quint8>((2 << 5) | (1 + driveStep_ / 8 % 26));   // ACC enabled, limit 5 to 130
+        data[9] = static_cast<quint8>(100 - driveStep_ * 3 % 101);  // Battery
+        ++driveStep_;
+    }
+    return result;
+}
+
+int TinklaRelayFaultInjectionBackend::bulkTransfer(libusb_device_handle *handle, quint8 endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout)
+{
+    Q_UNUSED(endpoint);
+    Q_UNUSED(data);
+    int result = transferResult(handle, length, timeout);
+    if (transferred != nullptr) {
+        *transferred = result < 0 ? 0 : result;
+    }
+    return result < 0 ? result : 0;
+}
+
+static quint64 percentile(const QVector<quint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int index = static_cast<int>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+int tinklaRelayRunSoak(const TinklaRelaySoakOptions &options)
+{
+    const quint64 endUs = static_cast<quint64>(options.hours * 3600.0 * 1e6);
+    const quint64 pollUs = static_cast<quint64>(options.pollIntervalMs) * 1000;
+    const quint64 stuckUs = static_cast<quint64>(options.stuckLimitMs) * 1000;
+    quint64 clockUs = 0;
+    std::mt19937 schedule(options.seed);
+    TinklaRelayFaultInjectionBackend backend(&clockUs, options.seed ^ 0x5eed);
+    TinklaRelayUsbBackend::setCurrent(&backend);
+
+    QVector<quint64> recoveries[TinklaRelayFaultInjectionBackend::NUM_FAULTS];
+    int stuck[TinklaRelayFaultInjectionBackend::NUM_FAULTS] = {};
+    int leaks = 0;
+    int restarts = 0;
+    quint64 polls = 0;
+    QElapsedTimer wall;
+    wall.start();
+    {
+        //what a running HUD owns: the driver, its connection state machine and the screen decisions on top
+        std::unique_ptr<TinklaRelayDriver> driver(new TinklaRelayDriver);
+        std::unique_ptr<TinklaRelayConnection> connection(new TinklaRelayConnection(*driver));
+        TinklaRelayScreenMode screen;
+        TinklaRelayFaultInjectionBackend::Fault recoveringFrom = TinklaRelayFaultInjectionBackend::FAULT_NONE;
+        quint64 clearedAtUs = 0;
+        quint64 nextChangeUs = 30 * 1000000ULL;  // Let the first connection settle
+        while (clockUs < endUs) {
+            if (clockUs >= nextChangeUs) {
+                if (backend.fault() == TinklaRelayFaultInjectionBackend::FAULT_NONE) {
+                    int fault = std::uniform_int_distribution<int>(1, TinklaRelayFaultInjectionBackend::NUM_FAULTS - 1)(schedule);
+                    backend.setFault(static_cast<TinklaRelayFaultInjectionBackend::Fault>(fault));
+                    nextChangeUs = clockUs + std::uniform_int_distribution<quint64>(200000, 30000000)(schedule);
+                    recoveringFrom = TinklaRelayFaultInjectionBackend::FAULT_NONE;
+                    if (std::uniform_int_distribution<int>(1, SIM_RESTART_ONE_IN)(schedule) == 1) {
+                        connection.reset();
+                        driver.reset(new TinklaRelayDriver);
+                        connection.reset(new TinklaRelayConnection(*driver));
+                        screen = TinklaRelayScreenMode();
+                        screen.warmStarted(clockUs / 1000);
+                        ++restarts;
+                    }
+                } else {
+                    recoveringFrom = backend.fault();
+                    clearedAtUs = clockUs;
+                    backend.setFault(TinklaRelayFaultInjectionBackend::FAULT_NONE);
+                    nextChangeUs = clockUs + std::uniform_int_distribution<quint64>(stuckUs + 5000000, 120000000)(schedule);
+                }
+            }
+            bool gotData = false;
+            TinklaRelayConnection::Event event = connection->poll(&gotData);
+            ++polls;
+            //the order TinklaRelayHUD::usbComm() and drawHud() see them in
+            if (event != TinklaRelayConnection::EVENT_NONE) {
+                screen.connectionChanged(event == TinklaRelayConnection::EVENT_CONNECTED, clockUs / 1000);
+            }
+            if (gotData) {
+                screen.freshData();
+            }
+            screen.tick(clockUs / 1000);
+            //recovered once fresh data is on the live gauges, not just flowing behind the spinner or the snapshot
+            bool live = screen.screen() == TinklaRelayScreenMode::SCREEN_LIVE && !screen.stale();
+            if (recoveringFrom != TinklaRelayFaultInjectionBackend::FAULT_NONE) {
+                if (gotData && live) {
+                    recoveries[recoveringFrom].append(clockUs - clearedAtUs);
+                    recoveringFrom = TinklaRelayFaultInjectionBackend::FAULT_NONE;
+                } else if (clockUs - clearedAtUs > stuckUs) {
+                    ++stuck[recoveringFrom];
+                    printf("STUCK: %s %.1f s after '%s' cleared at t=%.1f s\n",
+                           screen.screen() == TinklaRelayScreenMode::SCREEN_SPINNER ? "spinner"
+                           : screen.screen() == TinklaRelayScreenMode::SCREEN_SNAPSHOT || screen.stale() ? "stale snapshot" : "no data",
+                           (clockUs - clearedAtUs) / 1e6, TinklaRelayFaultInjectionBackend::faultName(recoveringFrom), clearedAtUs / 1e6);
+                    recoveringFrom = TinklaRelayFaultInjectionBackend::FAULT_NONE;
+                }
+            }
+            if (backend.liveHandles() > 1 || backend.liveContexts() > 1) {
+                ++leaks;
+            }
+            clockUs += pollUs;
+        }
+    }
+    if (backend.liveHandles() != 0 || backend.liveContexts() != 0) {
+        ++leaks;
+    }
+    TinklaRelayUsbBackend::setCurrent(nullptr);
+
+    printf("Soak: %.1f h simulated in %.1f s wall, %llu polls, %d warm restarts, seed %u\n",
+           endUs / 3.6e9, wall.elapsed() / 1000.0, static_cast<unsigned long long>(polls), restarts, options.seed);
+    printf("%-12s %6s %8s %8s %8s %8s %6s\n", "fault", "count", "p50 ms", "p90 ms", "p99 ms", "max ms", "stuck");
+    int totalStuck = 0;
+    for (int f = 1; f < TinklaRelayFaultInjectionBackend::NUM_FAULTS; ++f) {
+        QVector<quint64> sorted = recoveries[f];
+        std::sort(sorted.begin(), sorted.end());
+        printf("%-12s %6d %8.0f %8.0f %8.0f %8.0f %6d\n", TinklaRelayFaultInjectionBackend::faultName(static_cast<TinklaRelayFaultInjectionBackend::Fault>(f)),
+               sorted.size(), percentile(sorted, 0.5) / 1e3, percentile(sorted, 0.9) / 1e3, percentile(sorted, 0.99) / 1e3,
+               sorted.isEmpty() ? 0.0 : sorted.last() / 1e3, stuck[f]);
+        totalStuck += stuck[f];
+    }
+    printf("Leaked handles/contexts: %d, misused handles/contexts: %d, stuck states: %d\n", leaks, backend.misuseCount(), totalStuck);
+    bool passed = leaks == 0 && backend.misuseCount() == 0 && totalStuck == 0;
+    printf("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
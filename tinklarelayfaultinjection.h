@@ -0,0 +1,80 @@
+#ifndef TINKLARELAYFAULTINJECTION_H
+#define TINKLARELAYFAULTINJECTION_H
+
+// Includes
+#include <QHash>
+#include <random>
+#include "tinklarelayusbbackend.h"
+
+// Simulated relay behind a scripted USB backend. Every call advances a simulated clock by a plausible
+// latency, so hours of disconnect storms can be replayed through TinklaRelayDriver in seconds
+class TinklaRelayFaultInjectionBackend : public TinklaRelayUsbBackend
+{
+public:
+    enum Fault {
+        FAULT_NONE = 0,     // Healthy relay
+        FAULT_UNPLUGGED,    // Device gone: not listed, transfers return LIBUSB_ERROR_NO_DEVICE
+        FAULT_IO,           // Transfers return LIBUSB_ERROR_IO
+        FAULT_PIPE,         // Transfers return LIBUSB_ERROR_PIPE
+        FAULT_TIMEOUT,      // Transfers block for the full timeout and return LIBUSB_ERROR_TIMEOUT
+        FAULT_SHORT_READ,   // Transfers return fewer bytes than requested
+        FAULT_BUSY,         // Device re-enumerated (brownout) and claiming the interface returns LIBUSB_ERROR_BUSY
+        FAULT_FLAPPING,     // Hotplug flapping: the device keeps appearing and disappearing
+        NUM_FAULTS
+    };
+    static const char *faultName(Fault fault);
+
+    TinklaRelayFaultInjectionBackend(quint64 *clockUs, quint32 seed);
+
+    void setFault(Fault fault);
+    void setDriveData(bool drive);    // Besides the speed, sweep power, battery, ACC speed and limit; the flags stay fixed
+    Fault fault() const;
+    int liveContexts() const;
+    int liveHandles() const;
+    int misuseCount() const;  // Calls made with a context or handle that was never opened or already closed
+
+    int init(libusb_context **context) override;
+    void exit(libusb_context *context) override;
+    ssize_t findSerials(libusb_context *context, quint16 vid, quint16 pid, QStringList &serials) override;
+    libusb_device_handle *openDevice(libusb_context *context, quint16 vid, quint16 pid, const QString &serial) override;
+    void close(libusb_device_handle *handle) override;
+    int kernelDriverActive(libusb_device_handle *handle, int interface) override;
+    int detachKernelDriver(libusb_device_handle *handle, int interface) override;
+    int attachKernelDriver(libusb_device_handle *handle, int interface) override;
+    int claimInterface(libusb_device_handle *handle, int interface) override;
+    int releaseInterface(libusb_device_handle *handle, int interface) override;
+    int controlTransfer(libusb_device_handle *handle, quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, unsigned int timeout) override;
+    int bulkTransfer(libusb_device_handle *handle, quint8 endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) override;
+private:
+    quint64 *clockUs_;
+    std::mt19937 rng_;
+    Fault fault_;
+    bool present_;
+    quint64 nextFlapUs_;
+    quint32 generation_;            // Bumped on every unplug or re-enumeration, stale handles then fail
+    quintptr nextToken_;
+    QHash<quintptr, bool> contexts_;
+    QHash<quintptr, quint32> handles_;  // Handle -> generation it was opened in
+    int misuse_;
+    quint8 frameCounter_;
+    bool driveData_;
+    quint32 driveStep_;
+
+    void advance(quint64 us);
+    void setPresent(bool present);
+    void updateFlapping();
+    int transferResult(libusb_device_handle *handle, int length, unsigned int timeout);
+};
+
+struct TinklaRelaySoakOptions {
+    double hours;          // Simulated duration
+    quint32 seed;          // Seed of the fault schedule
+    int pollIntervalMs;    // Tick of the connection state machine, same as the HUD's USB timer
+    int stuckLimitMs;      // Live gauges not back this long after a fault cleared count as a stuck state
+};
+
+// Runs the connection state machine and the HUD's screen decisions against the fault-injection backend and prints a report
+// Returns 0 when the live gauges came back after every fault and no handle or context leaked, 1 otherwise
+int tinklaRelayRunSoak(const TinklaRelaySoakOptions &options);
+
+#endif // TINKLARELAYFAULTINJECTION_H
@@ -0,0 +1,114 @@
+// Includes
+#include <QPainter>
+#include "tinklarelayenergygauge.h"
+#include "tinklarelayframecache.h"
+#include "tinklarelaymetrics.h"
+
+TinklaRelayFrameCache::TinklaRelayFrameCache() :
+    frames_(0)
+{
+    for (int i = 0; i < VISIT_SLOTS; ++i) {
+        visitKeys_[i] = NO_KEY;
+        visitCounts_[i] = 0;
+    }
+}
+
+void TinklaRelayFrameCache::setBudgetKb(int budgetKb)
+{
+    frames_.setMaxCost(qMax(0, budgetKb));
+}
+
+bool TinklaRelayFrameCache::enabled() const
+{
+    return frames_.maxCost() > 0;
+}
+
+quint64 TinklaRelayFrameCache::key(const TinklaRelayState &state, bool carOffVisible, bool flipH, bool flipV, int speedSignRegion, int qrtrVal)
+{
+    //the same reductions as TinklaRelayRenderWorker::drawEnergy()
+    int powerAngle = 90 * TinklaRelayEnergyGauge::gaugeValue(state.rel_power_lvl) / qrtrVal;
+    int batteryAngle = 90 * state.rel_battery_lvl / qrtrVal;
+    int batteryColor = state.rel_battery_lvl <= 5 ? 2 : (state.rel_battery_lvl <= 20 ? 1 : 0);
+    int accStatus = qMin<int>(state.rel_acc_status, 2);   // Everything above 1 shows as enabled
+    const bool flags[14] = {
+        state.rel_AP_available, state.rel_AP_on,
+        state.rel_gear_in_reverse, state.rel_gear_in_forward, state.rel_gear_in_neutral,
+        state.rel_left_side_bsm, state.rel_right_side_bsm,
+        state.rel_light_on, state.rel_highbeams_on,
+        state.rel_left_turn_signal, state.rel_right_turn_signal,
+        state.rel_tpms_alert_on, state.rel_brake_hold_on,
+        carOffVisible
+    };
+    quint64 key = 0;
+    for (int i = 0; i < 14; ++i) {
+        key |= static_cast<quint64>(flags[i]) << i;
+    }
+    key |= static_cast<quint64>(state.rel_speed) << 14;
+    key |= static_cast<quint64>(state.rel_speed_limit) << 22;
+    key |= static_cast<quint64>(accStatus) << 30;
+    key |= static_cast<quint64>(accStatus != 0 ? state.rel_acc_speed : 0) << 32;
+    key |= static_cast<quint64>(powerAngle & 0xFF) << 40;
+    key |= static_cast<quint64>(state.rel_power_lvl < 0) << 48;
+    key |= static_cast<quint64>(batteryAngle & 0xFF) << 49;
+    key |= static_cast<quint64>(batteryColor) << 57;
+    key |= static_cast<quint64>(flipH) << 59;
+    key |= static_cast<quint64>(flipV) << 60;
+    key |= static_cast<quint64>(qBound(0, speedSignRegion, 2)) << 61;
+    return key;
+}
+
+const QPixmap *TinklaRelayFrameCache::find(quint64 key)
+{
+    const QPixmap *frame = frames_.object(key);
+    if (frame != nullptr) {
+        TinklaRelayMetrics::instance().frameCacheHits.inc();
+    } else {
+        TinklaRelayMetrics::instance().frameCacheMisses.inc();
+    }
+    return frame;
+}
+
+bool TinklaRelayFrameCache::visit(quint64 key)
+{
+    int slot = static_cast<int>(((key * 0x9E3779B97F4A7C15ull) >> 32) % VISIT_SLOTS);   // Neighbouring speeds spread over the table
+    if (visitKeys_[slot] != key) {
+        visitKeys_[slot] = key;
+        visitCounts_[slot] = 0;
+    }
+    if (visitCounts_[slot] < CAPTURE_AFTER_VISITS) {
+        visitCounts_[slot]++;
+    }
+    return visitCounts_[slot] >= CAPTURE_AFTER_VISITS;
+}
+
+void TinklaRelayFrameCache::insert(quint64 key, const QPixmap &frame)
+{
+    int cost = qMax(1, static_cast<int>(static_cast<qint64>(frame.width()) * frame.height() * frame.depth() / 8 / 1024));
+    int before = frames_.size();
+    bool replaced = frames_.contains(key);
+    frames_.insert(key, new QPixmap(frame), cost);  // Deleted right away when it is over the whole budget
+    int evicted = before + (replaced ? 0 : 1) - frames_.size();
+    if (evicted > 0) {
+        TinklaRelayMetrics::instance().frameCacheEvictions.inc(static_cast<quint64>(evicted));
+    }
+    TinklaRelayMetrics::instance().frameCacheBytes.set(static_cast<quint64>(frames_.totalCost()) * 1024);
+}
+
+TinklaRelayFrameView::TinklaRelayFrameView(QWidget *parent) :
+    QWidget(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAttribute(Qt::WA_OpaquePaintEvent);   // The frame covers the whole widget, nothing to clear first
+}
+
+void TinklaRelayFrameView::setFrame(const QPixmap &frame)
+{
+    frame_ = frame;
+    update();
+}
+
+void TinklaRelayFrameView::paintEvent(QPaintEvent *)
+{
+    QPainter p(this);
+    p.drawPixmap(0, 0, frame_);
+}
@@ -0,0 +1,53 @@
+#ifndef TINKLARELAYFRAMECACHE_H
+#define TINKLARELAYFRAMECACHE_H
+
+// Includes
+#include <QCache>
+#include <QPixmap>
+#include <QWidget>
+#include "tinklarelaystate.h"
+
+// Fully composed HUD frames, least recently used first out, keyed by everything that is visible on screen.
+// The HUD state mostly cycles through a handful of values (a blinker at a light, steady TACC cruising),
+// and a frame seen before is shown with one blit instead of updating every widget again
+class TinklaRelayFrameCache
+{
+public:
+    static const quint64 NO_KEY = ~0ull;   // Never produced by key(), it only uses the low 63 bits
+    static const int CAPTURE_AFTER_VISITS = 3;   // Times the widgets have to arrive at a state before it is grabbed
+    static const int VISIT_SLOTS = 256;
+
+    TinklaRelayFrameCache();
+    void setBudgetKb(int budgetKb);   // 0 turns the cache off
+    bool enabled() const;
+
+    // Power and battery are reduced to the whole-degree gauge angles and colors they are drawn with,
+    // so two states with the same key give the same pixels
+    static quint64 key(const TinklaRelayState &state, bool carOffVisible, bool flipH, bool flipV, int speedSignRegion, int qrtrVal);
+
+    const QPixmap *find(quint64 key);   // Counts a hit or a miss
+    // Counts one more arrival at a state that was not cached, true from the CAPTURE_AFTER_VISITS-th on.
+    // Fixed table, a colliding state takes over the slot and starts from one again
+    bool visit(quint64 key);
+    void insert(quint64 key, const QPixmap &frame);
+private:
+    QCache<quint64, QPixmap> frames_;   // Cost in KB
+    quint64 visitKeys_[VISIT_SLOTS];
+    quint8 visitCounts_[VISIT_SLOTS];
+};
+
+// Shows a cached frame on top of the widgets it was grabbed from. Mouse events go through to them
+class TinklaRelayFrameView : public QWidget
+{
+public:
+    explicit TinklaRelayFrameView(QWidget *parent = nullptr);
+    void setFrame(const QPixmap &frame);   // Shares the pixmap, no copy
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QPixmap frame_;
+};
+
+#endif // TINKLARELAYFRAMECACHE_H
@@ -1,60 +1,188 @@
 #include "tinklarelayhud.h"
 #include "qpainter.h"
 #include "cmath"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <QGraphicsOpacityEffect>
+#include <QGuiApplication>
+#include <QScreen>
 #include "ui_tinklarelayhud.h"
+#include "tinklarelayalloccheck.h"
+#include "tinklarelayboot.h"
+#include "tinklarelaybootprofile.h"
 #include "tinklarelayhudsettings.h"
+#include "tinklarelaymetrics.h"
+#include "tinklarelayperfoverlay.h"
+#include "tinklarelaytrace.h"
+#include "tinklarelaywatchdog.h"
 
 const float TIMER_INTERVAL = 100;
-bool tinklaRelayConnected = false;
+const int SNAPSHOT_INTERVAL_MS = 1000;
+static_assert(TinklaRelayRenderWorker::LAYER_SPLASH_TEXT == TinklaRelayWarmStart::MAX_LAYERS,
+              "the warm-start snapshot keeps every layer but the splash text");
 bool tinklaRelaySplashMode = false;
 bool isStarting = false;
 
 TinklaRelayHUD::TinklaRelayHUD(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::TinklaRelayHUD)
+    , myTrConnection(myTr)
 {
     tinklaRelayAppSettings = new QSettings("./tinklaRelaySettings.ini",QSettings::NativeFormat);
+    TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_SETTINGS);
+    //startup phase timings, written once live data is on screen and again at exit
+    bootProfileFile_ = tinklaRelayAppSettings->value("BootProfileFile","./tinklaRelayBoot.txt").toString();
+    bootProfilePrint_ = tinklaRelayAppSettings->value("BootProfilePrint", false).toBool();
     flipH = tinklaRelayAppSettings->value("FlipHorizontally", false).toBool();
     flipV = tinklaRelayAppSettings->value("FlipVertically", false).toBool();
     speedSignRegion = tinklaRelayAppSettings->value("SpeedSignRegion",0).toInt();
+    //metrics endpoint, disabled unless a port or a socket path is configured
+    metricsServer_ = new TinklaRelayMetricsServer(this);
+    int metricsPort = tinklaRelayAppSettings->value("MetricsPort",0).toInt();
+    QString metricsSocket = tinklaRelayAppSettings->value("MetricsSocket","").toString();
+    if (metricsPort > 0) {
+        metricsServer_->listenTcp(static_cast<quint16>(metricsPort));
+    }
+    if (!metricsSocket.isEmpty()) {
+        metricsServer_->listenLocal(metricsSocket);
+    }
+    //live state for other local processes, an empty name turns it off
+    QString shmName = tinklaRelayAppSettings->value("SharedMemoryName",REL_SHM_DEFAULT_NAME).toString();
+    if (!shmName.isEmpty()) {
+        shmPublisher_.open(shmName.toLocal8Bit().constData());
+    }
+    //stall watchdog and tracing, both off unless configured
+    int stallThresholdMs = tinklaRelayAppSettings->value("StallThresholdMs",0).toInt();
+    traceFile_ = tinklaRelayAppSettings->value("TraceFile","").toString();
+    TinklaRelayTrace::setEnabled(stallThresholdMs > 0 || !traceFile_.isEmpty());
+    if (stallThresholdMs > 0) {
+        watchdog_ = new TinklaRelayStallWatchdog(stallThresholdMs, traceFile_, this);
+        watchdog_->start();
+    }
     ui->setupUi(this);
-    mySpeedFont = QFont(":/img/gotham.ttf",88);
-    myAccFont = QFont(":/img/gothamNarrow.otf",28);
-    mySpeedLimitFont = QFont(":/img/gothamNarrow.otf",24);
-    mySplashScreenMessageFont = QFont(":/img/gothamNarrow.otf",24);
-    accAvailable = QPixmap(":/img/accAvailable.png");
-    accEnabled = QPixmap(":/img/accEnabled.png");
+    TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_SETUP_UI);
+    //render at the native resolution, Resolution=WIDTHxHEIGHT overrides the detected screen size
+    QStringList resolution = tinklaRelayAppSettings->value("Resolution","").toString().split('x');
+    hudSize_ = QGuiApplication::primaryScreen()->size();
+    if (resolution.size() == 2 && resolution[0].toInt() > 0 && resolution[1].toInt() > 0) {
+        hudSize_ = QSize(resolution[0].toInt(), resolution[1].toInt());
+    }
+    scale_ = qMin(hudSize_.width() / qreal(TRHUD_W), hudSize_.height() / qreal(TRHUD_H));
+    scaleLayout();
+    mySpeedFont = QFont(":/img/gotham.ttf",qRound(88 * scale_));
+    myAccFont = QFont(":/img/gothamNarrow.otf",qRound(28 * scale_));
+    mySpeedLimitFont = QFont(":/img/gothamNarrow.otf",qRound(24 * scale_));
+    mySplashScreenMessageFont = QFont(":/img/gothamNarrow.otf",qRound(24 * scale_));
+    //images, the spinner frames and the relay search are prepared on worker threads while the
+    //window is already up, each result is put on screen by the GUI thread as soon as it is ready
+    boot_ = new TinklaRelayBoot(this);
+    int assetsTask = boot_->add("bootAssets", QList<int>(), [this]() { loadAssets(); }, [this]() { applyAssets(); });
+    boot_->add("bootSpinner", QList<int>() << assetsTask, [this]() { prepSpinnerTracks(); }, [this]() { applySpinnerTracks(); });
+    //real-time mode searches from its own acquisition thread
+    if (!tinklaRelayAppSettings->value("RealtimeAcquisition", false).toBool()) {
+        bootUsbTask_ = boot_->add("bootUsb", QList<int>(), [this]() { myTrConnection.poll(); }, [this]() { usbDiscovered(); });
+    }
+    boot_->start();
+    for (int i = 0; i < 256; ++i) {
+        numberText_[i] = QString::number(i);
+    }
     isStarting = true;
     spinnerText = "Starting...";
     //0-US, 1-CA, 2-EU/ROW
     switch(speedSignRegion) {
         case 0:
-            ui->speedLimitSign->setPixmap(QPixmap(":/img/speedLimitUS.png"));
-            ui->speedLimitValue->setGeometry(ui->speedLimitValue->x(),ui->speedLimitValue->y()-2,
-                                    ui->speedLimitValue->width(),ui->speedLimitValue->height());
-            break;
         case 1:
-            ui->speedLimitSign->setPixmap(QPixmap(":/img/speedLimitCA.png"));
-            ui->speedLimitValue->setGeometry(ui->speedLimitValue->x(),ui->speedLimitValue->y()-2,
+            ui->speedLimitValue->setGeometry(ui->speedLimitValue->x(),ui->speedLimitValue->y()-qRound(2 * scale_),
                                     ui->speedLimitValue->width(),ui->speedLimitValue->height());
             break;
         default:
-            ui->speedLimitSign->setPixmap(QPixmap(":/img/speedLimitEU.png"));
-            ui->speedLimitSign->setGeometry(ui->speedLimitSign->x(),ui->speedLimitSign->y()-15,
+            ui->speedLimitSign->setGeometry(ui->speedLimitSign->x(),ui->speedLimitSign->y()-qRound(15 * scale_),
                                     ui->speedLimitSign->width(),ui->speedLimitSign->height());
-            ui->speedLimitValue->setGeometry(ui->speedLimitValue->x(),ui->speedLimitValue->y()-20,
+            ui->speedLimitValue->setGeometry(ui->speedLimitValue->x(),ui->speedLimitValue->y()-qRound(20 * scale_),
                                     ui->speedLimitValue->width(),ui->speedLimitValue->height());
             break;
     }
     flipLayout();
-    prepSpinnerTracks();
+    TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_FLIP_LAYOUT);
+    //dynamic layers are rasterized off the GUI thread
+    renderJob_.layers = 0;
+    renderJob_.pwrUsed = 0;
+    renderJob_.pwrAvailable = 0;
+    renderJob_.sourceNs = 0;
+    renderWorker_ = new TinklaRelayRenderWorker(this);
+    TinklaRelayRenderWorker::EnergyGeometry energyGeometry;
+    energyGeometry.centerX = ui->energyBar->width() / 2;
+    energyGeometry.centerY = ui->energyBar->height() / 2;
+    energyGeometry.radius = qRound(engRad * scale_);
+    energyGeometry.qrtrVal = qrtrVal;
+    energyGeometry.scale = scale_;
+    renderWorker_->setFlip(flipH, flipV);
+    renderWorker_->configureEnergy(ui->energyBar->size(), energyGeometry);
+    renderWorker_->configureText(TinklaRelayRenderWorker::LAYER_SPEED, ui->speedVal->size(), mySpeedFont, QColor("white"));
+    renderWorker_->configureText(TinklaRelayRenderWorker::LAYER_SPEED_LIMIT, ui->speedLimitValue->size(), mySpeedLimitFont, QColor("black"));
+    renderWorker_->configureText(TinklaRelayRenderWorker::LAYER_ACC_SPEED, ui->accSpeedValue->size(), myAccFont, QColor("white"));
+    renderWorker_->configureText(TinklaRelayRenderWorker::LAYER_SPLASH_TEXT, ui->zSpinnerText->size(), mySplashScreenMessageFont, QColor("white"));
+    layerLabels_[TinklaRelayRenderWorker::LAYER_ENERGY] = ui->energyBar;
+    layerLabels_[TinklaRelayRenderWorker::LAYER_SPEED] = ui->speedVal;
+    layerLabels_[TinklaRelayRenderWorker::LAYER_SPEED_LIMIT] = ui->speedLimitValue;
+    layerLabels_[TinklaRelayRenderWorker::LAYER_ACC_SPEED] = ui->accSpeedValue;
+    layerLabels_[TinklaRelayRenderWorker::LAYER_SPLASH_TEXT] = ui->zSpinnerText;
+    for (int layer = 0; layer < TinklaRelayRenderWorker::NUM_LAYERS; ++layer) {
+        layerLabels_[layer]->clear();
+        layerViews_[layer] = new TinklaRelayLayerView(layerLabels_[layer]);
+        layerViews_[layer]->setGeometry(layerLabels_[layer]->rect());
+    }
+    connect(renderWorker_, SIGNAL(frameReady()), this, SLOT(presentRenderedLayers()));
+    renderWorker_->start();
+    screenClock_.start();
+    //warm start: draw the last snapshot right away, dimmed until the relay answers again
+    //kept on tmpfs, it is rewritten every second and only has to outlive a crash or restart, not a reboot
+    QString warmStartFile = tinklaRelayAppSettings->value("WarmStartFile","/dev/shm/tinklaRelayHUD.warm").toString();
+    if (!warmStartFile.isEmpty()) {
+        TinklaRelayWarmStart::Layout layout;
+        layout.screen = hudSize_;
+        layout.flipH = flipH;
+        layout.flipV = flipV;
+        layout.speedSignRegion = speedSignRegion;
+        for (int layer = 0; layer < TinklaRelayWarmStart::MAX_LAYERS; ++layer) {
+            layout.layers[layer] = layerLabels_[layer]->size();
+        }
+        if (warmStart_.open(warmStartFile, layout)) {
+            restoreSnapshot();
+            snapshotTimer_ = new QTimer(this);
+            connect(snapshotTimer_, SIGNAL(timeout()), this, SLOT(saveSnapshot()));
+            snapshotTimer_->start(SNAPSHOT_INTERVAL_MS);
+        }
+    }
     updateTimer_ = new QTimer(this);
     splashTimer_ = new QTimer(this);
     usbCommTimer_ = new QTimer(this);
+    graceTimer_ = new QTimer(this);
+    graceTimer_->setSingleShot(true);
     connect(updateTimer_, SIGNAL(timeout()), this, SLOT(screenUpdate()));
     connect(splashTimer_, SIGNAL(timeout()), this, SLOT(drawSplash()));
     connect(usbCommTimer_, SIGNAL(timeout()), this, SLOT(usbComm()));
+    connect(graceTimer_, SIGNAL(timeout()), this, SLOT(warmStartExpired()));
     connect(ui->settingsButton,SIGNAL(clicked()),this,SLOT(openSettings()));
+    //performance readout in the top corner, mirrored along with the layout
+    if (tinklaRelayAppSettings->value("PerfOverlay", false).toBool()) {
+        QFont overlayFont("Monospace", qRound(12 * scale_));
+        overlayFont.setStyleHint(QFont::TypeWriter);
+        perfOverlay_ = new TinklaRelayPerfOverlay(overlayFont, flipH, flipV, ui->centralwidget);
+        int margin = qRound(10 * scale_);
+        perfOverlay_->move(flipH ? hudSize_.width() - perfOverlay_->width() - margin : margin,
+                           flipV ? hudSize_.height() - perfOverlay_->height() - margin : margin);
+        perfOverlay_->raise();
+    }
+    //whole-frame cache on top of the widgets, under the performance readout
+    frameCache_.setBudgetKb(tinklaRelayAppSettings->value("FrameCacheMB", 0).toInt() * 1024);
+    frameView_ = new TinklaRelayFrameView(ui->centralwidget);
+    frameView_->setGeometry(0, 0, hudSize_.width(), hudSize_.height());
+    frameView_->hide();
+    if (perfOverlay_ != nullptr) {
+        perfOverlay_->raise();
+    }
 }
 
 
@@ -69,6 +197,39 @@ void TinklaRelayHUD::openSettings(){
 void TinklaRelayHUD::setBrightnessControllPath(QString path) {
     brightnessControllPath = path;
     brightnessEnabled = true;
+    brightnessFd_ = ::open(brightnessControllPath.toLocal8Bit().constData(), O_WRONLY | O_CLOEXEC);
+}
+
+// Scales the design layout uniformly to the screen and centers it, the rest of the screen stays black
+void TinklaRelayHUD::scaleLayout() {
+    int offsetX = (hudSize_.width() - qRound(TRHUD_W * scale_)) / 2;
+    int offsetY = (hudSize_.height() - qRound(TRHUD_H * scale_)) / 2;
+    QList<QWidget *> list = ui->centralwidget->findChildren<QWidget *>(QString(), Qt::FindDirectChildrenOnly);
+    foreach(QWidget *w, list)
+    {
+        //scale the edges rather than the size so neighbouring widgets keep touching
+        QRect g = w->geometry();
+        int x0 = offsetX + qRound(g.left() * scale_);
+        int y0 = offsetY + qRound(g.top() * scale_);
+        int x1 = offsetX + qRound((g.right() + 1) * scale_);
+        int y1 = offsetY + qRound((g.bottom() + 1) * scale_);
+        w->setGeometry(x0, y0, x1 - x0, y1 - y0);
+        QFont f = w->font();
+        if (f.pointSizeF() > 0) {
+            f.setPointSizeF(f.pointSizeF() * scale_);
+        } else {
+            f.setPixelSize(qRound(f.pixelSize() * scale_));
+        }
+        w->setFont(f);
+    }
+    ui->settingsButton->setIconSize(ui->settingsButton->iconSize() * scale_);
+    setMinimumSize(0, 0);
+    ui->centralwidget->setMinimumSize(0, 0);
+    QPalette pal = ui->centralwidget->palette();
+    pal.setColor(QPalette::Window, Qt::black);
+    ui->centralwidget->setPalette(pal);
+    ui->centralwidget->setAutoFillBackground(true);
+    resize(hudSize_);
 }
 
 void TinklaRelayHUD::flipLayout() {
@@ -82,13 +243,13 @@ void TinklaRelayHUD::flipLayout() {
         int nx = x;
         int ny = y;
         if (flipH) {
-            nx = TRHUD_W - x - w;
+            nx = hudSize_.width() - x - w;
             if (l->pixmap() != 0) {
                 l->setPixmap(l->pixmap()->transformed(QTransform().scale(-1, 1)));
             }
         }
         if (flipV) {
-           ny = TRHUD_H - y - h;
+           ny = hudSize_.height() - y - h;
             if (l->pixmap() != 0) {
                 l->setPixmap(l->pixmap()->transformed(QTransform().scale(1, -1)));
             }
@@ -98,6 +259,7 @@ void TinklaRelayHUD::flipLayout() {
 }
 
 void TinklaRelayHUD::setSpeedLimit(uint8_t speed) {
+    TINKLA_TRACE_SPAN("setSpeedLimit");
     if (speed == 0) {
         ui->speedLimitSign->setVisible(false);
         ui->speedLimitValue->setVisible(false);
@@ -105,33 +267,38 @@ void TinklaRelayHUD::setSpeedLimit(uint8_t speed) {
         ui->speedLimitSign->setVisible(true);
         ui->speedLimitValue->setVisible(true);
         if (speed != oldSpeedLimit) {
-            writeTextToLabel(ui->speedLimitValue,QString::number(speed),mySpeedLimitFont,QColor("black"));
+            writeTextToLayer(TinklaRelayRenderWorker::LAYER_SPEED_LIMIT,numberText_[speed]);
             oldSpeedLimit = speed;
         }
     }
 }
 
 void TinklaRelayHUD::setAccLimit(uint8_t status, uint8_t speed) {
+    TINKLA_TRACE_SPAN("setAccLimit");
     //0 unavailable, 1 available, 2 enabled
     if (status == 0) {
         ui->accSpeedSign->setVisible(false);
         ui->accSpeedValue->setVisible(false);
     } else {
         if (status == 1) {
-            ui->accSpeedSign->setPixmap(accAvailable);
-        } else {
+            if (oldAccStatus_ != 1) {
+                ui->accSpeedSign->setPixmap(accAvailable);
+            }
+        } else if (oldAccStatus_ != 2) {
             ui->accSpeedSign->setPixmap(accEnabled);
         }
         ui->accSpeedSign->setVisible(true);
         ui->accSpeedValue->setVisible(true);
         if (speed != oldAccSpeed) {
-            writeTextToLabel(ui->accSpeedValue,QString::number(speed),myAccFont,QColor("white"));
+            writeTextToLayer(TinklaRelayRenderWorker::LAYER_ACC_SPEED,numberText_[speed]);
             oldAccSpeed = speed;
         }
     }
+    oldAccStatus_ = qMin<int>(status, 2);
 }
 
 void TinklaRelayHUD::setGear(bool in_reverse, bool in_forward, bool in_neutral) {
+    TINKLA_TRACE_SPAN("setGear");
     ui->maskGearD->setVisible(!in_forward);
     ui->maskGearN->setVisible(!in_neutral);
     ui->maskGearR->setVisible(!in_reverse);
@@ -143,221 +310,223 @@ void TinklaRelayHUD::setGear(bool in_reverse, bool in_forward, bool in_neutral)
 }
 
 void TinklaRelayHUD::setApStatus(bool AP_available,bool AP_on) {
+    TINKLA_TRACE_SPAN("setApStatus");
     ui->apStatusAvailable->setVisible(AP_available);
     ui->apStatusEnabled->setVisible(AP_on);
 }
 
 void TinklaRelayHUD::drawEnergy(int pwrUsed , int pwrAvailable) {
-    //rescale energy
-   int engScaled = 0;
-   if (pwrUsed > 0) {
-       engScaled = std::min(posScale[0],pwrUsed);
-       for (int i=0;i<posScaleLen-1;i++) {
-          if (pwrUsed > posScale[i]) {
-            engScaled += (int)((std::min(posScale[i+1],pwrUsed) - posScale[i])/pow(2,i+1));
-          }
-       }
-   }
-   if (pwrUsed < 0) {
-       engScaled = std::max(negScale[0],pwrUsed);
-       for (int i=0;i<negScaleLen-1;i++) {
-          if (pwrUsed < negScale[i]) {
-            engScaled += (int)((std::max(negScale[i+1],pwrUsed) - negScale[i])/pow(2,i+1));
-          }
-       }
-       //rescale like positive
-       engScaled = (int)(engScaled * posScale[0] / std::abs(negScale[0]));
-   }
-   //compute ccenter angles
-   float centerAngleDeg = (90 * engScaled / qrtrVal);
-   float centerAngleDegBatt = (90 * pwrAvailable / qrtrVal);
-   int angleSign = 1;
-   if (centerAngleDeg != 0) {
-       angleSign = (int)(centerAngleDeg/std::abs(centerAngleDeg));
-   }
-   if (std::abs(centerAngleDeg) <= 2) {
-       angleSign = 0;
-   }
-   if (centerAngleDegBatt > 2) {
-       centerAngleDegBatt = centerAngleDegBatt - 2 ;
-   }
-   centerAngleDeg = centerAngleDeg - 2 * angleSign;
-   //setup the drawing area
-   QPixmap pixmap(ui->energyBar->width(),ui->energyBar->height());
-   pixmap.fill(QColor("transparent"));
-   QPainter painter(&pixmap);
-   painter.setRenderHint(QPainter::Antialiasing);
-   //painter.setRenderHint(QPainter::HighQualityAntialiasing);
-   QRectF rectangle(center_x- engRad, center_y - engRad, 2*engRad, 2*engRad);
-   //now draw
-   int startAngle = 0;
-   int startAngleBatt = (int)(180 + 90 * 60/qrtrVal)*16; //60% is at 180 deg
-   if (flipH) {
-       startAngle = (180*16 - startAngle);
-       startAngleBatt = (180*16 - startAngleBatt);
-   }
-   if (flipV) {
-       startAngleBatt = (360*16 - startAngleBatt);
-   }
-   int spanAngle = (centerAngleDeg) * 16;
-   int spanAngleBatt = (-centerAngleDegBatt) * 16;
-   if ((flipH != flipV) && (flipH || flipV)) {
-       spanAngle = - spanAngle;
-       spanAngleBatt = -spanAngleBatt;
+   TINKLA_TRACE_SPAN("drawEnergy");
+   if (pwrUsed == oldPwrUsed_ && pwrAvailable == oldPwrAvailable_) {
+       return;
    }
-
-   QPen pen;
-   pen.setColor("orange");
-   pen.setWidth(15);
-   pen.setJoinStyle(Qt::RoundJoin);
-   if (pwrUsed < 0) {
-       pen.setBrush(Qt::green);
-   }
-   painter.setPen(pen);
-   painter.drawArc(rectangle, startAngle, spanAngle);
-   pen.setBrush(Qt::green);
-   if (pwrAvailable <= 20) {
-       pen.setColor("orange");
-   }
-   if (pwrAvailable <= 5) {
-       pen.setColor("red");
-   }
-   painter.setPen(pen);
-   painter.drawArc(rectangle, startAngleBatt, spanAngleBatt);
-   //compute power marker
-   int x = (int)((engRad -10) * cos((centerAngleDeg + 1 * angleSign)*3.14159/180));
-   int y = (int)((engRad -10) * sin((centerAngleDeg + 1 * angleSign)*3.14159/180));
-   int lineAngle = centerAngleDeg;
-   int bx = (int)((engRad -10) * cos((180 + 90 * 60/qrtrVal - centerAngleDegBatt - 1)*3.14159/180));
-   int by = (int)((engRad -10) * sin((180 + 90 * 60/qrtrVal - centerAngleDegBatt - 1)*3.14159/180));
-   int lineAngleBatt = (int)(180 + 90 * 60/qrtrVal - centerAngleDegBatt );
-   //flip markers
-   if (flipH) {
-       x = -x;
-       bx = -bx;
-       lineAngle = 180 - lineAngle;
-       lineAngleBatt = 180 - lineAngleBatt;
-   }
-   if (flipV) {
-       y = -y;
-       by = - by;
-       lineAngle = -lineAngle;
-       lineAngleBatt = - lineAngleBatt;
-   }
-   //draw markers
-   pen.setColor("white");
-   pen.setWidth(4);
-   painter.setPen(pen);
-   QLineF marker;
-   marker.setP1(QPointF(center_x+x,center_y-y));
-   marker.setAngle(lineAngle);
-   marker.setLength(25);
-   painter.drawLine(marker);
-   QLineF markerBatt;
-   markerBatt.setP1(QPointF(center_x+bx,center_y-by));
-   markerBatt.setAngle(lineAngleBatt);
-   markerBatt.setLength(25);
-   painter.drawLine(markerBatt);
-   ui->energyBar->setPixmap(pixmap);
+   renderJob_.pwrUsed = pwrUsed;
+   renderJob_.pwrAvailable = pwrAvailable;
+   renderJob_.layers |= 1u << TinklaRelayRenderWorker::LAYER_ENERGY;
+   oldPwrUsed_ = pwrUsed;
+   oldPwrAvailable_ = pwrAvailable;
 }
 
 void TinklaRelayHUD::setBlindSpot(bool leftBSM, bool rightBSM) {
+    TINKLA_TRACE_SPAN("setBlindSpot");
     ui->hideLeftBsm->setVisible(!leftBSM);
     ui->hideRightBsm->setVisible(!rightBSM);
 }
 
 void TinklaRelayHUD::setLights(bool lightsOn, bool highBeamOn) {
+    TINKLA_TRACE_SPAN("setLights");
     ui->hideLoBeam->setVisible(!lightsOn);
     ui->hideHiBeam->setVisible(!highBeamOn);
 }
 
 void TinklaRelayHUD::setTurnSignals(bool leftTs, bool rightTs) {
+    TINKLA_TRACE_SPAN("setTurnSignals");
     ui->hideLeftTs->setVisible(!leftTs);
     ui->hideRightTs->setVisible(!rightTs);
 }
 
 void TinklaRelayHUD::setSpeed(int speed) {
+    TINKLA_TRACE_SPAN("setSpeed");
     if (speed != oldSpeed) {
-        writeTextToLabel(ui->speedVal,QString::number(speed),mySpeedFont,QColor("white"));
+        writeTextToLayer(TinklaRelayRenderWorker::LAYER_SPEED,(speed >= 0 && speed < 256) ? numberText_[speed] : QString::number(speed));
         oldSpeed = speed;
     }
 }
 
 void TinklaRelayHUD::setTireAlert(bool tpmsAlert) {
+    TINKLA_TRACE_SPAN("setTireAlert");
     ui->hideLoTirePres->setVisible(!tpmsAlert);
 }
 
 void TinklaRelayHUD::setBrakeHold(bool applied) {
+    TINKLA_TRACE_SPAN("setBrakeHold");
     ui->hideBrakeHold->setVisible(!applied);
 }
 
-void TinklaRelayHUD::writeTextToLabel(QLabel *theLabel, QString theString, QFont theFont, QColor theColor) {
-    theLabel->setText("");
-    QPixmap pm(QSize(theLabel->width(),theLabel->height()));
-    pm.fill(QColor("transparent"));
-    QPainter p(&pm);
-    p.setPen(theColor);
-    p.setFont(theFont);
-    p.drawText(QRectF(0, 0, theLabel->width(), theLabel->height()), Qt::AlignVCenter | Qt::AlignHCenter, theString);
-    QTransform tr;
-    if (flipH) {
-        tr.scale(-1,1);
+void TinklaRelayHUD::writeTextToLayer(TinklaRelayRenderWorker::Layer layer, const QString &theString) {
+    renderJob_.text[layer] = theString;
+    renderJob_.layers |= 1u << layer;
+}
+
+//points the layer views at the images the render worker finished
+void TinklaRelayHUD::presentRenderedLayers() {
+    TINKLA_TRACE_SPAN("presentRenderedLayers");
+    const QImage *images[TinklaRelayRenderWorker::NUM_LAYERS];
+    quint64 sourceNs = 0;
+    quint32 mask = renderWorker_->takeFinished(images, &sourceNs);
+    for (int layer = 0; layer < TinklaRelayRenderWorker::NUM_LAYERS; ++layer) {
+        if (mask & (1u << layer)) {
+            layerViews_[layer]->setImage(images[layer]);
+        }
     }
-    if (flipV) {
-        tr.scale(1,-1);
+    if (mask != 0) {
+        TinklaRelayMetrics::instance().framesPresented.inc();
+        snapshotDirty_ |= mask;
+    }
+    //the labels repaint in this same event loop pass, so this is close to decode-to-pixel
+    if (sourceNs != 0 && sourceNs != presentedSourceNs_) {
+        TinklaRelayMetrics::instance().frameLatency.observe((TinklaRelayTrace::nowNs() - sourceNs) / 1000);
+        presentedSourceNs_ = sourceNs;
     }
-    theLabel->setPixmap(pm.transformed(tr));
 }
 
 void TinklaRelayHUD::drawHud()
 {
+   TINKLA_TRACE_SPAN("drawHud");
+   TINKLA_ALLOC_FRAME("drawHud");
+   QElapsedTimer renderTimer;
+   renderTimer.start();
+   if (acquisition_ != nullptr) {
+       acquisition_->latest(myTr.state, &decodedNs_);
+   }
+   if (stale_ && decodedNs_ != 0) {
+       screenMode_.freshData();
+       showScreen();
+   }
+   if (decodedNs_ != 0 && !TinklaRelayBootProfile::reached(TinklaRelayBootProfile::PHASE_LIVE_DATA)) {
+       TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_LIVE_DATA);
+       writeBootProfile();
+   }
+   //a state shown before comes back as one cached frame, without touching the widgets
+   quint64 frameKey = TinklaRelayFrameCache::NO_KEY;
+   if (frameCache_.enabled() && !stale_ && !tinklaRelaySplashMode) {
+       frameKey = TinklaRelayFrameCache::key(myTr.state, (!myTr.state.rel_car_on) && (!isStarting), flipH, flipV, speedSignRegion, qrtrVal);
+       const QPixmap *frame = frameCache_.find(frameKey);
+       if (frame != nullptr) {
+           showCachedFrame(frameKey, *frame);
+           setBrightness((int)(myTr.state.rel_brightness * 2.55));
+           TinklaRelayMetrics::instance().renderTime.observe(static_cast<quint64>(renderTimer.nsecsElapsed() / 1000));
+           return;
+       }
+   }
+   hideCachedFrame();
    //for debug uncomment this
-   //myTr.rel_car_on = true;
-   setSpeed(myTr.rel_speed);
-   setSpeedLimit(myTr.rel_speed_limit);
-   setAccLimit(myTr.rel_acc_status,myTr.rel_acc_speed);
-   setApStatus(myTr.rel_AP_available,myTr.rel_AP_on);
-   setGear(myTr.rel_gear_in_reverse, myTr.rel_gear_in_forward, myTr.rel_gear_in_neutral);
-   setBlindSpot(myTr.rel_left_side_bsm,myTr.rel_right_side_bsm);
-   setLights(myTr.rel_light_on,myTr.rel_highbeams_on);
-   setTurnSignals(myTr.rel_left_turn_signal,myTr.rel_right_turn_signal);
-   setTireAlert(myTr.rel_tpms_alert_on);
-   setBrakeHold(myTr.rel_brake_hold_on);
-   drawEnergy(myTr.rel_power_lvl,myTr.rel_battery_lvl);
-   ui->zzzCarOff->setVisible((!myTr.rel_car_on) && (!tinklaRelaySplashMode) && (!isStarting));
-   setBrightness((int)(myTr.rel_brightness * 2.55));
+   //myTr.state.rel_car_on = true;
+   setSpeed(myTr.state.rel_speed);
+   setSpeedLimit(myTr.state.rel_speed_limit);
+   setAccLimit(myTr.state.rel_acc_status,myTr.state.rel_acc_speed);
+   setApStatus(myTr.state.rel_AP_available,myTr.state.rel_AP_on);
+   setGear(myTr.state.rel_gear_in_reverse, myTr.state.rel_gear_in_forward, myTr.state.rel_gear_in_neutral);
+   setBlindSpot(myTr.state.rel_left_side_bsm,myTr.state.rel_right_side_bsm);
+   setLights(myTr.state.rel_light_on,myTr.state.rel_highbeams_on);
+   setTurnSignals(myTr.state.rel_left_turn_signal,myTr.state.rel_right_turn_signal);
+   setTireAlert(myTr.state.rel_tpms_alert_on);
+   setBrakeHold(myTr.state.rel_brake_hold_on);
+   drawEnergy(myTr.state.rel_power_lvl,myTr.state.rel_battery_lvl);
+   ui->zzzCarOff->setVisible((!myTr.state.rel_car_on) && (!tinklaRelaySplashMode) && (!isStarting));
+   setBrightness((int)(myTr.state.rel_brightness * 2.55));
+   //an unchanged frame leaves the worker asleep
+   if (renderJob_.layers != 0) {
+       renderJob_.sourceNs = decodedNs_;
+       renderWorker_->submit(renderJob_);
+       renderJob_.layers = 0;
+   }
+   //grabbing the window is a full render, only states that keep coming back are worth it
+   if (frameKey != widgetFrameKey_) {
+       captureDue_ = frameKey != TinklaRelayFrameCache::NO_KEY && frameCache_.visit(frameKey);
+   } else if (captureDue_ && renderWorker_->idle()) {
+       //unchanged since the last update and every layer is on screen, so the widgets show exactly this state
+       captureFrame(frameKey);
+       captureDue_ = false;
+   }
+   widgetFrameKey_ = frameKey;
+   TinklaRelayMetrics::instance().renderTime.observe(static_cast<quint64>(renderTimer.nsecsElapsed() / 1000));
 }
 
+// Boot worker thread: QImage only, flipped like the labels they end up in
 void TinklaRelayHUD::prepSpinnerTracks() {
-  QPixmap track_img = QPixmap(":/img/spinnerTrack.png");
-
-  QTransform transform(1, 0, 0, 1, 180, 180);
-  QPixmap pm(QSize(360, 360));
-  QPainter p(&pm);
-  p.setRenderHint(QPainter::SmoothPixmapTransform);
+  QImage track_img = assets_.image("spinnerTrack.png");
+  //rotate around the middle of the image, its size depends on the resolution
+  qreal cx = track_img.width() / 2.0;
+  qreal cy = track_img.height() / 2.0;
   for (int i = 0; i < numbSpinnerTracks; ++i) {
     QTransform tr;
-    tr.translate(180, 180);
+    tr.translate(cx, cy);
     tr.rotate(i * 360 / numbSpinnerTracks);
-    tr.translate(-180, -180);
-    spinnerTrackImgs[i] = track_img.transformed(tr);
+    tr.translate(-cx, -cy);
+    spinnerTrackFrames_[i] = track_img.transformed(tr).mirrored(flipH, flipV);
+  }
+  TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_SPINNER);
+}
+
+void TinklaRelayHUD::applySpinnerTracks() {
+  for (int i = 0; i < numbSpinnerTracks; ++i) {
+    spinnerTrackImgs[i] = QPixmap::fromImage(std::move(spinnerTrackFrames_[i]));
+  }
+  ui->zSpinnerTrack->setPixmap(spinnerTrackImgs[spinnerTrackPos]);
+}
+
+// Boot worker thread. Images come pre-decoded from the asset blob, only the ones this configuration shows are touched;
+// other resolutions use a blob scaled on first start and cached next to the default one
+void TinklaRelayHUD::loadAssets() {
+  assets_.openForScreen(hudSize_, scale_);
+  //labels are mirrored with the layout, the settings button is not
+  const char *labelImages[6] = {"accAvailable.png", "accEnabled.png", "apAvailable.png", "apEnabled.png", "background.png", "spinnerBkg.png"};
+  for (int i = 0; i < 6; ++i) {
+    bootImages_[labelImages[i]] = assets_.image(labelImages[i]).mirrored(flipH, flipV);
   }
+  //0-US, 1-CA, 2-EU/ROW
+  const char *speedLimitSign = speedSignRegion == 0 ? "speedLimitUS.png" : (speedSignRegion == 1 ? "speedLimitCA.png" : "speedLimitEU.png");
+  bootImages_["speedLimit"] = assets_.image(speedLimitSign).mirrored(flipH, flipV);
+  bootImages_["settings.png"] = assets_.image("settings.png");
+  TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_ASSETS);
+}
+
+void TinklaRelayHUD::applyAssets() {
+  accAvailable = QPixmap::fromImage(bootImages_.take("accAvailable.png"));
+  accEnabled = QPixmap::fromImage(bootImages_.take("accEnabled.png"));
+  ui->Background->setPixmap(QPixmap::fromImage(bootImages_.take("background.png")));
+  ui->accSpeedSign->setPixmap(oldAccStatus_ == 2 ? accEnabled : accAvailable);
+  ui->apStatusAvailable->setPixmap(QPixmap::fromImage(bootImages_.take("apAvailable.png")));
+  ui->apStatusEnabled->setPixmap(QPixmap::fromImage(bootImages_.take("apEnabled.png")));
+  ui->zSpinnerBkg->setPixmap(QPixmap::fromImage(bootImages_.take("spinnerBkg.png")));
+  ui->speedLimitSign->setPixmap(QPixmap::fromImage(bootImages_.take("speedLimit")));
+  ui->settingsButton->setIcon(QIcon(QPixmap::fromImage(bootImages_.take("settings.png"))));
 }
 
 void TinklaRelayHUD::setSplash(bool isVisible) {
+    TINKLA_TRACE_SPAN("setSplash");
     tinklaRelaySplashMode = isVisible;
     isStarting = false;
     ui->zSpinnerBkg->setVisible(tinklaRelaySplashMode);
     ui->zSpinnerTrack->setVisible(tinklaRelaySplashMode);
     ui->zSpinnerText->setVisible(tinklaRelaySplashMode);
     ui->zzzCarOff->setVisible((!tinklaRelaySplashMode) && (!isStarting));
-    if (isVisible) setBrightness(255);
+    if (isVisible) {
+        hideCachedFrame();
+        setBrightness(255);
+    }
 }
 
 void TinklaRelayHUD::drawSplash() {
+    TINKLA_TRACE_SPAN("drawSplash");
     ui->zSpinnerTrack->setPixmap(spinnerTrackImgs[spinnerTrackPos]);
-    ui->zSpinnerText->setText(spinnerText);
-    writeTextToLabel(ui->zSpinnerText,spinnerText,mySplashScreenMessageFont,QColor("white"));
+    if (spinnerText != oldSpinnerText) {
+        writeTextToLayer(TinklaRelayRenderWorker::LAYER_SPLASH_TEXT,spinnerText);
+        renderWorker_->submit(renderJob_);
+        renderJob_.layers = 0;
+        oldSpinnerText = spinnerText;
+    }
     spinnerTrackPos = (spinnerTrackPos + 1) % numbSpinnerTracks;
     if (spinnerTrackPos == 0) {
         spinnerText = "Searching for Tinkla Relay...";
@@ -365,30 +534,86 @@ void TinklaRelayHUD::drawSplash() {
 }
 
 void TinklaRelayHUD::startUsbTimer(int interval) {
-    usbCommTimer_->start(interval);
+    if (!tinklaRelayAppSettings->value("RealtimeAcquisition", false).toBool()) {
+        if (bootUsbTask_ >= 0 && !boot_->isFinished(bootUsbTask_)) {
+            usbTimerInterval_ = interval;  // Started by usbDiscovered()
+            return;
+        }
+        usbCommTimer_->start(interval);
+        return;
+    }
+    TinklaRelayRealtimeOptions options;
+    options.priority = tinklaRelayAppSettings->value("RealtimePriority", 50).toInt();
+    options.cpu = tinklaRelayAppSettings->value("RealtimeCpu", -1).toInt();
+    options.periodMs = tinklaRelayAppSettings->value("RealtimePeriodMs", interval).toInt();
+    options.searchMs = interval;
+    options.lockMemory = tinklaRelayAppSettings->value("RealtimeLockMemory", true).toBool();
+    acquisition_ = new TinklaRelayAcquisitionThread(options, shmPublisher_.isOpen() ? &shmPublisher_ : nullptr, this);
+    connect(acquisition_, SIGNAL(connectionChanged(bool)), this, SLOT(relayConnectionChanged(bool)));
+    acquisition_->start();
 }
 
 void TinklaRelayHUD::startUpdateTimer(int interval) {
-    setSplash(false);
-    splashTimer_->stop();
-    updateTimer_->start(interval);
+    updateInterval_ = interval;
+    shownScreen_ = -1;  // Restarts the timer if the gauges are already up
+    showScreen();
 }
 
 void TinklaRelayHUD::startSpinnerTimer(int interval) {
-    setSplash(true);
-    updateTimer_->stop();
-    splashTimer_->start(interval);
+    spinnerInterval_ = interval;
+    shownScreen_ = -1;
+    showScreen();
+}
+
+// Puts the splash, the timers and the dimming in line with screenMode_, the same decisions the soak checks
+void TinklaRelayHUD::showScreen() {
+    if (stale_ != screenMode_.stale()) {
+        setStale(screenMode_.stale());
+    }
+    TinklaRelayScreenMode::Screen screen = screenMode_.screen();
+    if (screen == shownScreen_) {
+        return;
+    }
+    shownScreen_ = screen;
+    graceTimer_->stop();
+    switch (screen) {
+        case TinklaRelayScreenMode::SCREEN_LIVE:
+            setSplash(false);
+            splashTimer_->stop();
+            updateTimer_->start(updateInterval_);
+            break;
+        case TinklaRelayScreenMode::SCREEN_SNAPSHOT:
+            //the snapshot stays up for a grace period, the spinner only comes if the relay stays away
+            setSplash(false);
+            splashTimer_->stop();
+            updateTimer_->stop();
+            graceTimer_->start(static_cast<int>(screenMode_.graceLeftMs(static_cast<quint64>(screenClock_.elapsed()))));
+            break;
+        default:
+            setSplash(true);
+            updateTimer_->stop();
+            splashTimer_->start(spinnerInterval_);
+            break;
+    }
 }
 
 void TinklaRelayHUD::setBrightness(int brightness) {
+    TINKLA_TRACE_SPAN("setBrightness");
     if (!brightnessEnabled) return;
     if (brightness == previousBrightness) return;
-    if ((!myTr.rel_car_on) && (!tinklaRelaySplashMode)) brightness = 0;
-    QFile brightnessFile(brightnessControllPath);
-    brightnessFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    brightnessFile.write(QString::number(brightness).toUtf8());
-    brightnessFile.close();
+    if ((!myTr.state.rel_car_on) && (!tinklaRelaySplashMode)) brightness = 0;
+    if (brightnessFd_ < 0) {
+        brightnessFd_ = ::open(brightnessControllPath.toLocal8Bit().constData(), O_WRONLY | O_CLOEXEC);
+    }
+    char value[16];
+    int len = snprintf(value, sizeof(value), "%d", brightness);
+    //sysfs takes the whole value at offset 0, the truncate only matters for a plain file
+    if (brightnessFd_ >= 0 && (pwrite(brightnessFd_, value, static_cast<size_t>(len), 0) != len || ftruncate(brightnessFd_, len) != 0)) {
+        ::close(brightnessFd_);
+        brightnessFd_ = -1;  // Reopened on the next change
+    }
     previousBrightness = brightness;
+    TinklaRelayMetrics::instance().brightnessWrites.inc();
 }
 
 void TinklaRelayHUD::screenUpdate()
@@ -397,59 +622,144 @@ void TinklaRelayHUD::screenUpdate()
 }
 
 void TinklaRelayHUD::usbComm() {
-    if(myTr.disconnected()) {
-        if (tinklaRelayConnected) {
-            //we were connected before
-            tinklaRelayConnected = false;
-            startSpinnerTimer(50);
-            myTr.close();
-            //printf("Got disconnected!\n");
-        }
-        int errcnt = 0;
-        QString errstr;
-        QStringList trDevs = TinklaRelayDriver::listDevices(errcnt, errstr);
-        if (errcnt > 0) {
-            //error, return
-            //printf("Error on list devices!\n");
-            return;
-        } else {
-            if (trDevs.length() > 0) {
-                //found device
-                int err = myTr.open(trDevs[0]);
-                if (err == TinklaRelayDriver::SUCCESS) {  // Device was successfully opened
-                    //printf("Got connected!\n");
-                    return;
-                } else if (err == TinklaRelayDriver::ERROR_INIT) {  // Failed to initialize libusb
-                    //printf("Failed to initialize libusb!\n");
-                    return;
-                } else {
-                    if (err == TinklaRelayDriver::ERROR_NOT_FOUND) {  // Failed to find device
-                        //printf("Failed to find device!\n");
-                        return;
-                    } else if (err == TinklaRelayDriver::ERROR_BUSY) {  // Failed to claim interface
-                        //printf("Failed to claim interface!\n");
-                        return;
-                    }
-                }
-            }
-        }
-     } else {
-        if (!tinklaRelayConnected) {
-            tinklaRelayConnected = true;
-            startUpdateTimer(100);
-        }
-        if (myTr.getData()) {
-            //printf("Got data and processing it!\n");
-            myTr.processDataMessage();
-        } else {
-            //printf("Failed to get data!\n");
-        }
+    TINKLA_TRACE_SPAN("usbComm");
+    TINKLA_ALLOC_FRAME("usbComm");
+    bool gotData = false;
+    TinklaRelayConnection::Event event = myTrConnection.poll(&gotData);
+    if (gotData) {
+        decodedNs_ = TinklaRelayTrace::nowNs();
+        shmPublisher_.publish(TinklaRelayShmPublisher::realtimeUs(), myTr.rawData(), myTr.state);
+    }
+    switch (event) {
+        case TinklaRelayConnection::EVENT_DISCONNECTED:
+            shmPublisher_.setConnected(false);
+            relayConnectionChanged(false);
+            break;
+        case TinklaRelayConnection::EVENT_CONNECTED:
+            relayConnectionChanged(true);
+            break;
+        default:
+            break;
+    }
+}
 
+// The boot search has opened the relay if it is there, so the first poll does not wait for a timer tick
+void TinklaRelayHUD::usbDiscovered() {
+    if (usbTimerInterval_ < 0) {
+        return;  // startUsbTimer() not called yet, it starts the timer itself
     }
+    usbComm();
+    usbCommTimer_->start(usbTimerInterval_);
+}
+
+void TinklaRelayHUD::relayConnectionChanged(bool connected) {
+    screenMode_.connectionChanged(connected, static_cast<quint64>(screenClock_.elapsed()));
+    showScreen();
 }
 
 TinklaRelayHUD::~TinklaRelayHUD()
 {
+    delete boot_;  // Waits for its workers, they use the members below
+    saveSnapshot();
+    writeBootProfile();
+    if (bootProfilePrint_) {
+        TinklaRelayBootProfile::print();
+    }
+    delete acquisition_;  // Before shmPublisher_ goes away
+    if (brightnessFd_ >= 0) {
+        ::close(brightnessFd_);
+    }
+    delete watchdog_;
+    if (!traceFile_.isEmpty()) {
+        TinklaRelayTrace::writeChromeTrace(traceFile_.toLocal8Bit().constData());
+    }
+    renderWorker_->stop();
     delete ui;
 }
 
+
+void TinklaRelayHUD::paintEvent(QPaintEvent *event) {
+    QMainWindow::paintEvent(event);
+    TinklaRelayBootProfile::mark(TinklaRelayBootProfile::PHASE_FIRST_PAINT);
+}
+
+void TinklaRelayHUD::showCachedFrame(quint64 key, const QPixmap &frame) {
+    if (key == shownFrameKey_) {
+        return;
+    }
+    frameView_->setFrame(frame);
+    frameView_->show();
+    shownFrameKey_ = key;
+}
+
+void TinklaRelayHUD::hideCachedFrame() {
+    if (shownFrameKey_ != TinklaRelayFrameCache::NO_KEY) {
+        frameView_->hide();
+        shownFrameKey_ = TinklaRelayFrameCache::NO_KEY;
+    }
+}
+
+// The performance readout changes every second, it stays out of the cached frames
+void TinklaRelayHUD::captureFrame(quint64 key) {
+    bool overlayShown = perfOverlay_ != nullptr && perfOverlay_->isVisible();
+    if (overlayShown) {
+        perfOverlay_->hide();
+    }
+    frameCache_.insert(key, ui->centralwidget->grab());
+    if (overlayShown) {
+        perfOverlay_->show();
+    }
+}
+
+void TinklaRelayHUD::writeBootProfile() {
+    if (!bootProfileFile_.isEmpty()) {
+        TinklaRelayBootProfile::write(bootProfileFile_.toLocal8Bit().constData());
+    }
+}
+
+// Layers come back as they were presented, the state is re-rendered by the first drawHud()
+void TinklaRelayHUD::restoreSnapshot() {
+    quint32 mask = 0;
+    if (!warmStart_.load(myTr.state, warmLayers_, &mask)) {
+        return;
+    }
+    for (int layer = 0; layer < TinklaRelayWarmStart::MAX_LAYERS; ++layer) {
+        if (mask & (1u << layer)) {
+            layerViews_[layer]->setImage(&warmLayers_[layer]);
+        }
+    }
+    screenMode_.warmStarted(static_cast<quint64>(screenClock_.elapsed()));
+    setStale(true);
+}
+
+void TinklaRelayHUD::setStale(bool stale) {
+    stale_ = stale;
+    hideCachedFrame();
+    if (stale) {
+        QGraphicsOpacityEffect *dim = new QGraphicsOpacityEffect(ui->centralwidget);
+        dim->setOpacity(0.5);
+        ui->centralwidget->setGraphicsEffect(dim);
+    } else {
+        ui->centralwidget->setGraphicsEffect(nullptr);  // Deletes the effect
+    }
+}
+
+void TinklaRelayHUD::warmStartExpired() {
+    screenMode_.tick(static_cast<quint64>(screenClock_.elapsed()));
+    showScreen();
+}
+
+// Only fresh data is saved, so a HUD that keeps restarting without a relay does not age its snapshot into the future
+void TinklaRelayHUD::saveSnapshot() {
+    if (!warmStart_.isOpen() || stale_ || decodedNs_ == 0) {
+        return;
+    }
+    QImage images[TinklaRelayWarmStart::MAX_LAYERS];
+    for (int layer = 0; layer < TinklaRelayWarmStart::MAX_LAYERS; ++layer) {
+        if ((snapshotDirty_ & (1u << layer)) && layerViews_[layer]->image() != nullptr) {
+            images[layer] = *layerViews_[layer]->image();   // Shared, the worker does not paint the shown buffer
+        }
+    }
+    warmStart_.save(myTr.state, images, snapshotDirty_);
+    snapshotDirty_ = 0;
+}
@@ -1,6 +1,7 @@
 #ifndef TINKARELAYHUD_H
 #define TINKARELAYHUD_H
 
+// Design size of the layout in the .ui file, other screens get it scaled uniformly
 #define TRHUD_W    800
 #define TRHUD_H   480
 
@@ -10,8 +11,25 @@
 #include <QFile>
 #include <QLabel>
 #include <QSettings>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QImage>
+#include <QMap>
 #include <array>
 #include "tinklarelaydriver.h"
+#include "tinklarelayconnection.h"
+#include "tinklarelayassets.h"
+#include "tinklarelayframecache.h"
+#include "tinklarelayrenderworker.h"
+#include "tinklarelayscreenmode.h"
+#include "tinklarelayshm.h"
+#include "tinklarelayacquisition.h"
+#include "tinklarelaywarmstart.h"
+
+class TinklaRelayBoot;
+class TinklaRelayMetricsServer;
+class TinklaRelayPerfOverlay;
+class TinklaRelayStallWatchdog;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class TinklaRelayHUD; }
@@ -33,17 +51,27 @@ public:
     bool flipH = false;
     int speedSignRegion = 0;
     QSettings *tinklaRelayAppSettings;
+protected:
+    void paintEvent(QPaintEvent *event) override;
 private slots:
     void screenUpdate();
     void drawSplash();
     void usbComm();
+    void relayConnectionChanged(bool connected);
     void openSettings();
+    void presentRenderedLayers();
+    void saveSnapshot();
+    void warmStartExpired();
+    void usbDiscovered();
 private:
     Ui::TinklaRelayHUD *ui;
+    TinklaRelayAssets assets_;
     QPixmap accEnabled;
     QPixmap accAvailable;
     QPixmap apAvailable;
     QPixmap apEnabled;
+    QSize hudSize_;
+    qreal scale_ = 1.0;
     QFont mySpeedFont = QFont(":/img/gotham.ttf",88);
     QFont myAccFont = QFont(":/img/gothamNarrow.otf",28);
     QFont mySpeedLimitFont = QFont(":/img/gothamNarrow.otf",24);
@@ -51,12 +79,46 @@ private:
     QTimer *updateTimer_;
     QTimer *splashTimer_;
     QTimer *usbCommTimer_;
+    QTimer *graceTimer_;            // Ends the warm-start grace period
 
     TinklaRelayDriver myTr;
+    TinklaRelayConnection myTrConnection;
+    TinklaRelayMetricsServer *metricsServer_;
+    TinklaRelayShmPublisher shmPublisher_;
+    TinklaRelayStallWatchdog *watchdog_ = nullptr;
+    QString traceFile_;
+    TinklaRelayAcquisitionThread *acquisition_ = nullptr;  // Only in real-time mode, then myTr is not polled and myTr.state mirrors it
+    TinklaRelayPerfOverlay *perfOverlay_ = nullptr;
+    quint64 decodedNs_ = 0;         // When the data in myTr.state was decoded, for the frame latency
+    quint64 presentedSourceNs_ = 0;
+    TinklaRelayWarmStart warmStart_;
+    QTimer *snapshotTimer_ = nullptr;
+    quint32 snapshotDirty_ = 0;     // Layers presented since the last snapshot
+    bool stale_ = false;            // Showing the warm-start snapshot, no fresh data yet
+    TinklaRelayScreenMode screenMode_;
+    QElapsedTimer screenClock_;     // Monotonic milliseconds for screenMode_
+    int shownScreen_ = -1;          // TinklaRelayScreenMode::Screen the timers were last set up for
+    int spinnerInterval_ = 50;
+    int updateInterval_ = 100;
+    TinklaRelayBoot *boot_ = nullptr;
+    QMap<QString, QImage> bootImages_;   // Decoded by the boot worker, turned into pixmaps by applyAssets()
+    int bootUsbTask_ = -1;               // Relay search at boot, -1 in real-time mode
+    int usbTimerInterval_ = -1;          // Requested while the boot search was still running
+    QString bootProfileFile_;
+    bool bootProfilePrint_ = false;
+    TinklaRelayFrameCache frameCache_;
+    TinklaRelayFrameView *frameView_ = nullptr;
+    quint64 shownFrameKey_ = TinklaRelayFrameCache::NO_KEY;    // Frame the view shows, NO_KEY while it is hidden
+    quint64 widgetFrameKey_ = TinklaRelayFrameCache::NO_KEY;   // State the widgets were last updated to
+    bool captureDue_ = false;                                  // Grab widgetFrameKey_ once the widgets have settled
 
     int oldSpeedLimit = 0;
     int oldAccSpeed = 0;
     int oldSpeed = 0;
+    int oldAccStatus_ = -1;
+    int oldPwrUsed_ = 0;
+    int oldPwrAvailable_ = -1;   // Forces the first gauge render
+    QString numberText_[256];    // Preformatted values, so a changed number does not allocate a string
 
     void setSpeedLimit(uint8_t speed);
     void setAccLimit(uint8_t status, uint8_t speed);
@@ -70,24 +132,37 @@ private:
     void setTireAlert(bool tpmsAlert);
     void setBrakeHold(bool applied);
     void setSplash(bool isVisible);
+    void scaleLayout();
+    void restoreSnapshot();
+    void setStale(bool stale);
+    void showScreen();
+    void writeBootProfile();
+    void showCachedFrame(quint64 key, const QPixmap &frame);
+    void hideCachedFrame();
+    void captureFrame(quint64 key);
     void flipLayout();
-    void writeTextToLabel(QLabel *theLabel, QString theString, QFont theFont, QColor theColor);
-    const int center_x = 240;
-    const int center_y = 200;
-    const int engRad = 180;
+    void writeTextToLayer(TinklaRelayRenderWorker::Layer layer, const QString &theString);
+    const int engRad = 180;    // Gauge radius at the design size
     const int qrtrVal = 120;
-    const int posScale[4] = {40,80,160,320};
-    const int negScale[2] = {-30,-60};
-    const int posScaleLen = sizeof(posScale)/sizeof(posScale[0]);
-    const int negScaleLen = sizeof(negScale)/sizeof(negScale[0]);
+    TinklaRelayRenderWorker *renderWorker_;
+    TinklaRelayRenderWorker::Job renderJob_;
+    QLabel *layerLabels_[TinklaRelayRenderWorker::NUM_LAYERS];
+    TinklaRelayLayerView *layerViews_[TinklaRelayRenderWorker::NUM_LAYERS];   // Show the worker's buffers over the labels
+    QImage warmLayers_[TinklaRelayWarmStart::MAX_LAYERS];                     // Shown until the worker has rendered the layer
     //spinner stuff
     int numbSpinnerTracks = 30;
     int spinnerTrackPos = 0;
     std::array<QPixmap, 30> spinnerTrackImgs;
     QString spinnerText = "";
+    QString oldSpinnerText = "";
+    std::array<QImage, 30> spinnerTrackFrames_;   // Filled by the boot worker
     void prepSpinnerTracks();
+    void applySpinnerTracks();
+    void loadAssets();
+    void applyAssets();
     bool brightnessEnabled = false;
     QString brightnessControllPath = "";
+    int brightnessFd_ = -1;      // Kept open, reopened only after a failed write
     void setBrightness(int brightness);
     int previousBrightness = 0;
 };
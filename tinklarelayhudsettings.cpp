@@ -23,6 +23,7 @@ void tinklaRelayHudSettings::setExistingValues() {
     bool flipH = tinklaRelayAppSettings->value("FlipHorizontally", false).toBool();
     bool flipV = tinklaRelayAppSettings->value("FlipVertically", false).toBool();
     int speedSignRegion = tinklaRelayAppSettings->value("SpeedSignRegion",0).toInt();
+    ui->perfOverlay->setChecked(tinklaRelayAppSettings->value("PerfOverlay", false).toBool());
     switch (speedSignRegion) {
        case 0:
             ui->radioUS->setChecked(true);
@@ -73,6 +74,7 @@ void tinklaRelayHudSettings::saveButton() {
     if (ui->radioROW->isChecked()) {
         tinklaRelayAppSettings->setValue("SpeedSignRegion",2);
     }
+    tinklaRelayAppSettings->setValue("PerfOverlay",ui->perfOverlay->isChecked());
     close();
     qApp->exit(1337);
 }
@@ -0,0 +1,164 @@
+// Includes
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "tinklarelaymetrics.h"
+
+// Bucket upper bounds, from 100us (a healthy control transfer) up to 10s (a slow reconnect)
+const quint64 TinklaRelayHistogram::BOUNDS_US[TinklaRelayHistogram::NUM_BUCKETS] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 10000000
+};
+
+void TinklaRelayHistogram::observe(quint64 us)
+{
+    int i = 0;
+    while (i < NUM_BUCKETS && us > BOUNDS_US[i]) {
+        ++i;
+    }
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    last_.store(us, std::memory_order_relaxed);
+}
+
+TinklaRelayMetrics &TinklaRelayMetrics::instance()
+{
+    static TinklaRelayMetrics metrics;
+    return metrics;
+}
+
+static void appendCounter(QByteArray &out, const char *name, const char *help, const TinklaRelayCounter &counter)
+{
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += " counter\n";
+    out += name; out += ' '; out += QByteArray::number(counter.value()); out += '\n';
+}
+
+static void appendGauge(QByteArray &out, const char *name, const char *help, const TinklaRelayGauge &gauge)
+{
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += " gauge\n";
+    out += name; out += ' '; out += QByteArray::number(gauge.value()); out += '\n';
+}
+
+static void appendHistogram(QByteArray &out, const char *name, const char *help, const TinklaRelayHistogram &hist)
+{
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += " histogram\n";
+    quint64 cumulative = 0;
+    for (int i = 0; i < TinklaRelayHistogram::NUM_BUCKETS; ++i) {
+        cumulative += hist.bucket(i);
+        out += name; out += "_bucket{le=\"";
+        out += QByteArray::number(TinklaRelayHistogram::BOUNDS_US[i] / 1e6, 'g', 6);
+        out += "\"} "; out += QByteArray::number(cumulative); out += '\n';
+    }
+    cumulative += hist.bucket(TinklaRelayHistogram::NUM_BUCKETS);
+    out += name; out += "_bucket{le=\"+Inf\"} "; out += QByteArray::number(cumulative); out += '\n';
+    out += name; out += "_sum "; out += QByteArray::number(hist.sumUs() / 1e6, 'f', 6); out += '\n';
+    out += name; out += "_count "; out += QByteArray::number(hist.count()); out += '\n';
+}
+
+// Only called when the endpoint is scraped, so allocating here is fine
+QByteArray TinklaRelayMetrics::toPrometheusText() const
+{
+    QByteArray out;
+    out.reserve(4096);
+    appendCounter(out, "tinklarelay_transfers_ok_total", "USB transfers that completed successfully.", transfersOk);
+    appendCounter(out, "tinklarelay_transfers_failed_total", "USB transfers that failed or were short.", transfersFailed);
+    appendCounter(out, "tinklarelay_disconnects_total", "Times the relay went from connected to disconnected.", disconnects);
+    appendCounter(out, "tinklarelay_reconnects_total", "Times the relay went from disconnected to connected.", reconnects);
+    appendCounter(out, "tinklarelay_frames_decoded_total", "Relay data messages decoded.", framesDecoded);
+    appendCounter(out, "tinklarelay_brightness_writes_total", "Writes to the backlight brightness control.", brightnessWrites);
+    appendCounter(out, "tinklarelay_stalls_total", "GUI event loop stalls longer than the watchdog threshold.", stalls);
+    appendCounter(out, "tinklarelay_frames_presented_total", "Rendered HUD layer sets presented on screen.", framesPresented);
+    appendCounter(out, "tinklarelay_frame_cache_hits_total", "HUD updates shown from a cached whole frame.", frameCacheHits);
+    appendCounter(out, "tinklarelay_frame_cache_misses_total", "HUD updates that had to update the widgets.", frameCacheMisses);
+    appendCounter(out, "tinklarelay_frame_cache_evictions_total", "Cached frames dropped to stay within the memory budget.", frameCacheEvictions);
+    appendGauge(out, "tinklarelay_frame_cache_bytes", "Memory held by cached frames.", frameCacheBytes);
+    appendHistogram(out, "tinklarelay_usb_round_trip_seconds", "Duration of one relay data poll.", usbRoundTrip);
+    appendHistogram(out, "tinklarelay_reconnect_seconds", "Time from disconnect until the relay was open again.", reconnectTime);
+    appendHistogram(out, "tinklarelay_render_seconds", "Duration of one HUD redraw.", renderTime);
+    appendHistogram(out, "tinklarelay_acquisition_lateness_seconds", "How late the real-time acquisition thread woke up after its deadline.", acquisitionLateness);
+    appendHistogram(out, "tinklarelay_stall_seconds", "Duration of GUI event loop stalls.", stallTime);
+    appendHistogram(out, "tinklarelay_frame_latency_seconds", "Time from decoding a relay frame to presenting it.", frameLatency);
+    return out;
+}
+
+TinklaRelayMetricsServer::TinklaRelayMetricsServer(QObject *parent) :
+    QObject(parent),
+    tcpServer_(nullptr),
+    localServer_(nullptr)
+{
+}
+
+bool TinklaRelayMetricsServer::listenTcp(quint16 port)
+{
+    if (tcpServer_ == nullptr) {
+        tcpServer_ = new QTcpServer(this);
+        connect(tcpServer_, SIGNAL(newConnection()), this, SLOT(newTcpConnection()));
+    }
+    return tcpServer_->listen(QHostAddress::LocalHost, port);
+}
+
+bool TinklaRelayMetricsServer::listenLocal(const QString &path)
+{
+    if (localServer_ == nullptr) {
+        localServer_ = new QLocalServer(this);
+        connect(localServer_, SIGNAL(newConnection()), this, SLOT(newLocalConnection()));
+    }
+    QLocalServer::removeServer(path);  // Clean up a stale socket left behind by a crash or a settings restart
+    return localServer_->listen(path);
+}
+
+void TinklaRelayMetricsServer::newTcpConnection()
+{
+    while (QTcpSocket *socket = tcpServer_->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void TinklaRelayMetricsServer::newLocalConnection()
+{
+    while (QLocalSocket *socket = localServer_->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+// Waits for the end of the request headers; the request itself is ignored, any path returns the metrics
+void TinklaRelayMetricsServer::readRequest()
+{
+    QIODevice *socket = qobject_cast<QIODevice *>(sender());
+    if (socket == nullptr) {
+        return;
+    }
+    QByteArray pending = socket->property("request").toByteArray() + socket->readAll();
+    if (pending.contains("\r\n\r\n") || pending.contains("\n\n")) {
+        serve(socket);
+    } else if (pending.size() > 8192) {  // Not a sane scrape request
+        socket->close();
+    } else {
+        socket->setProperty("request", pending);
+    }
+}
+
+void TinklaRelayMetricsServer::serve(QIODevice *socket)
+{
+    QByteArray body = TinklaRelayMetrics::instance().toPrometheusText();
+    QByteArray response = "HTTP/1.0 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Connection: close\r\n"
+                          "Content-Length: ";
+    response += QByteArray::number(body.size());
+    response += "\r\n\r\n";
+    response += body;
+    socket->write(response);
+    if (QTcpSocket *tcp = qobject_cast<QTcpSocket *>(socket)) {
+        tcp->disconnectFromHost();
+    } else if (QLocalSocket *local = qobject_cast<QLocalSocket *>(socket)) {
+        local->disconnectFromServer();
+    }
+}
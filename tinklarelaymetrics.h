@@ -0,0 +1,103 @@
+#ifndef TINKLARELAYMETRICS_H
+#define TINKLARELAYMETRICS_H
+
+// Includes
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+class QTcpServer;
+class QLocalServer;
+class QIODevice;
+
+// Monotonic counter. inc() is a single relaxed atomic add, safe to call from any thread
+class TinklaRelayCounter
+{
+public:
+    void inc(quint64 n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<quint64> value_{0};
+};
+
+// Value that goes up and down. set() is a single relaxed atomic store
+class TinklaRelayGauge
+{
+public:
+    void set(quint64 v) { value_.store(v, std::memory_order_relaxed); }
+    quint64 value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<quint64> value_{0};
+};
+
+// Fixed-bucket histogram of durations in microseconds. observe() never locks or allocates
+class TinklaRelayHistogram
+{
+public:
+    static const int NUM_BUCKETS = 18;
+    static const quint64 BOUNDS_US[NUM_BUCKETS];  // Upper bounds, the +Inf bucket is implicit
+
+    void observe(quint64 us);
+    quint64 count() const { return count_.load(std::memory_order_relaxed); }
+    quint64 sumUs() const { return sum_.load(std::memory_order_relaxed); }
+    quint64 bucket(int i) const { return buckets_[i].load(std::memory_order_relaxed); }  // Non-cumulative
+    quint64 lastUs() const { return last_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<quint64> buckets_[NUM_BUCKETS + 1] = {};
+    std::atomic<quint64> count_{0};
+    std::atomic<quint64> sum_{0};
+    std::atomic<quint64> last_{0};
+};
+
+// Process-wide registry of the HUD health metrics
+class TinklaRelayMetrics
+{
+public:
+    static TinklaRelayMetrics &instance();
+
+    TinklaRelayCounter transfersOk;      // Successful control/bulk transfers
+    TinklaRelayCounter transfersFailed;  // Failed control/bulk transfers
+    TinklaRelayCounter disconnects;      // Connected -> disconnected transitions
+    TinklaRelayCounter reconnects;       // Disconnected -> connected transitions
+    TinklaRelayCounter framesDecoded;    // Data messages run through processDataMessage()
+    TinklaRelayCounter brightnessWrites; // Writes to the backlight control file
+    TinklaRelayCounter stalls;           // GUI event loop stalls seen by the watchdog
+    TinklaRelayCounter framesPresented;  // Rendered layer sets swapped onto the screen
+    TinklaRelayCounter frameCacheHits;   // HUD updates shown from a cached frame
+    TinklaRelayCounter frameCacheMisses; // HUD updates that went through the widgets
+    TinklaRelayCounter frameCacheEvictions;
+    TinklaRelayGauge frameCacheBytes;
+    TinklaRelayHistogram usbRoundTrip;   // Duration of one getData() poll
+    TinklaRelayHistogram reconnectTime;  // From disconnect to the device being open again
+    TinklaRelayHistogram renderTime;     // Duration of one drawHud()
+    TinklaRelayHistogram acquisitionLateness;  // Wake-up lateness of the real-time acquisition thread
+    TinklaRelayHistogram stallTime;      // Duration of GUI event loop stalls
+    TinklaRelayHistogram frameLatency;   // From decoding a relay frame to its rendered layers being presented
+
+    QByteArray toPrometheusText() const;
+private:
+    TinklaRelayMetrics() = default;
+    Q_DISABLE_COPY(TinklaRelayMetrics)
+};
+
+// Serves the registry in Prometheus text format over a local TCP port or a Unix socket
+class TinklaRelayMetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TinklaRelayMetricsServer(QObject *parent = nullptr);
+    bool listenTcp(quint16 port);              // Binds to 127.0.0.1 only
+    bool listenLocal(const QString &path);
+private slots:
+    void newTcpConnection();
+    void newLocalConnection();
+    void readRequest();
+private:
+    QTcpServer *tcpServer_;
+    QLocalServer *localServer_;
+    void serve(QIODevice *socket);
+};
+
+#endif // TINKLARELAYMETRICS_H
@@ -0,0 +1,150 @@
+// Includes
+#include <QFontMetrics>
+#include <QPainter>
+#include <QTimer>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tinklarelayperfoverlay.h"
+#include "tinklarelaymetrics.h"
+
+const int OVERLAY_PADDING = 6;
+const int SAMPLE_INTERVAL_MS = 1000;
+
+// Reads a small /proc file into buf without going through the allocator, returns the length or -1
+static int readProcFile(const char *path, char *buf, int size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int len = static_cast<int>(read(fd, buf, static_cast<size_t>(size - 1)));
+    close(fd);
+    if (len < 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+TinklaRelayPerfOverlay::TinklaRelayPerfOverlay(const QFont &font, bool flipH, bool flipV, QWidget *parent) :
+    QWidget(parent),
+    flipH_(flipH),
+    flipV_(flipV),
+    lastPresented_(TinklaRelayMetrics::instance().framesPresented.value()),
+    lastDecoded_(TinklaRelayMetrics::instance().framesDecoded.value()),
+    lastCpuTicks_(cpuTicks())
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    //every glyph is rendered once, the readout is then only pixmap copies
+    QFontMetrics fm(font);
+    cellW_ = fm.maxWidth();
+    cellH_ = fm.height();
+    for (int i = 0; i < NUM_GLYPHS; ++i) {
+        glyphs_[i] = QPixmap(cellW_, cellH_);
+        glyphs_[i].fill(Qt::transparent);
+        QPainter p(&glyphs_[i]);
+        p.setFont(font);
+        p.setPen(Qt::white);
+        p.drawText(QRect(0, 0, cellW_, cellH_), Qt::AlignCenter, QString(QChar(FIRST_GLYPH + i)));
+    }
+    frame_ = QPixmap(LINE_LEN * cellW_ + 2 * OVERLAY_PADDING, NUM_LINES * cellH_ + 2 * OVERLAY_PADDING);
+    frame_.fill(Qt::transparent);
+    setFixedSize(frame_.size());
+    elapsed_.start();
+    timer_ = new QTimer(this);
+    connect(timer_, SIGNAL(timeout()), this, SLOT(sample()));
+    timer_->start(SAMPLE_INTERVAL_MS);
+}
+
+void TinklaRelayPerfOverlay::paintEvent(QPaintEvent *)
+{
+    QPainter p(this);
+    p.drawPixmap(0, 0, frame_);
+}
+
+void TinklaRelayPerfOverlay::sample()
+{
+    TinklaRelayMetrics &metrics = TinklaRelayMetrics::instance();
+    double seconds = qMax<qint64>(1, elapsed_.restart()) / 1000.0;
+    quint64 presented = metrics.framesPresented.value();
+    quint64 decoded = metrics.framesDecoded.value();
+    quint64 ticks = cpuTicks();
+    static const long TICKS_PER_SECOND = sysconf(_SC_CLK_TCK);
+    char lines[NUM_LINES][LINE_LEN + 1];
+    snprintf(lines[0], sizeof(lines[0]), "FPS %7.1f", (presented - lastPresented_) / seconds);
+    snprintf(lines[1], sizeof(lines[1]), "ACQ %7.1f Hz", (decoded - lastDecoded_) / seconds);
+    snprintf(lines[2], sizeof(lines[2]), "RTT %7.2f ms", metrics.usbRoundTrip.lastUs() / 1000.0);
+    snprintf(lines[3], sizeof(lines[3]), "ERR %7llu", static_cast<unsigned long long>(metrics.transfersFailed.value()));
+    snprintf(lines[4], sizeof(lines[4]), "LAT %7.1f ms", metrics.frameLatency.lastUs() / 1000.0);
+    snprintf(lines[5], sizeof(lines[5]), "CPU %7.1f %%", 100.0 * (ticks - lastCpuTicks_) / TICKS_PER_SECOND / seconds);
+    snprintf(lines[6], sizeof(lines[6]), "RSS %7.1f MB", rssBytes() / 1048576.0);
+    lastPresented_ = presented;
+    lastDecoded_ = decoded;
+    lastCpuTicks_ = ticks;
+    compose(lines);
+    update();
+}
+
+void TinklaRelayPerfOverlay::compose(const char (&lines)[NUM_LINES][LINE_LEN + 1])
+{
+    frame_.fill(QColor(0, 0, 0, 160));
+    QPainter p(&frame_);
+    //mirrored like the rest of the HUD so it reads right in the windshield
+    if (flipH_) {
+        p.translate(frame_.width(), 0);
+        p.scale(-1, 1);
+    }
+    if (flipV_) {
+        p.translate(0, frame_.height());
+        p.scale(1, -1);
+    }
+    for (int line = 0; line < NUM_LINES; ++line) {
+        for (int col = 0; col < LINE_LEN && lines[line][col] != '\0'; ++col) {
+            int glyph = static_cast<unsigned char>(lines[line][col]) - FIRST_GLYPH;
+            if (glyph > 0 && glyph < NUM_GLYPHS) {  // Spaces are left empty
+                p.drawPixmap(OVERLAY_PADDING + col * cellW_, OVERLAY_PADDING + line * cellH_, glyphs_[glyph]);
+            }
+        }
+    }
+}
+
+// User plus system time of the whole process, in clock ticks
+quint64 TinklaRelayPerfOverlay::cpuTicks()
+{
+    char buf[1024];
+    if (readProcFile("/proc/self/stat", buf, sizeof(buf)) < 0) {
+        return 0;
+    }
+    //the command name may contain spaces, the fields are counted from its closing parenthesis
+    const char *p = strrchr(buf, ')');
+    if (p == nullptr) {
+        return 0;
+    }
+    quint64 ticks = 0;
+    for (int field = 3; field <= 15 && *p != '\0'; ++field) {
+        while (*p != '\0' && *p != ' ') {
+            ++p;
+        }
+        while (*p == ' ') {
+            ++p;
+        }
+        if (field >= 14) {  // utime and stime
+            ticks += strtoull(p, nullptr, 10);
+        }
+    }
+    return ticks;
+}
+
+quint64 TinklaRelayPerfOverlay::rssBytes()
+{
+    char buf[256];
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    if (readProcFile("/proc/self/statm", buf, sizeof(buf)) < 0 || sscanf(buf, "%llu %llu", &size, &resident) != 2) {
+        return 0;
+    }
+    return static_cast<quint64>(resident) * static_cast<quint64>(sysconf(_SC_PAGESIZE));
+}
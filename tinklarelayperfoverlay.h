@@ -0,0 +1,51 @@
+#ifndef TINKLARELAYPERFOVERLAY_H
+#define TINKLARELAYPERFOVERLAY_H
+
+// Includes
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QFont>
+#include <QPixmap>
+
+class QTimer;
+
+// Optional on-screen performance readout for tuning a unit in the car. The text is composed from glyphs
+// rendered once at startup into a cached pixmap, and only once per second, so the overlay itself barely
+// shows up in the numbers it reports
+class TinklaRelayPerfOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    TinklaRelayPerfOverlay(const QFont &font, bool flipH, bool flipV, QWidget *parent = nullptr);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    void sample();
+
+private:
+    static const int FIRST_GLYPH = 32;
+    static const int NUM_GLYPHS = 95;  // Printable ASCII
+    static const int NUM_LINES = 7;
+    static const int LINE_LEN = 16;
+
+    QPixmap glyphs_[NUM_GLYPHS];
+    int cellW_;
+    int cellH_;
+    bool flipH_;
+    bool flipV_;
+    QPixmap frame_;
+    QTimer *timer_;
+    QElapsedTimer elapsed_;
+    quint64 lastPresented_;
+    quint64 lastDecoded_;
+    quint64 lastCpuTicks_;
+
+    void compose(const char (&lines)[NUM_LINES][LINE_LEN + 1]);
+    static quint64 cpuTicks();
+    static quint64 rssBytes();
+};
+
+#endif // TINKLARELAYPERFOVERLAY_H
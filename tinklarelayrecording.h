@@ -0,0 +1,20 @@
+#ifndef TINKLARELAYRECORDING_H
+#define TINKLARELAYRECORDING_H
+
+// Includes
+#include <stdint.h>
+#include "tinklarelaystate.h"
+
+// Binary recording: the 8-byte magic, then fixed-size records in acquisition order
+// Kept free of Qt so offline tools can read recordings
+#define REL_RECORDING_MAGIC "TRREC001"
+#define REL_RECORDING_MAGIC_LEN 8
+
+#pragma pack(push, 1)
+struct TinklaRelayRecord {
+    uint64_t timestampUs;          // CLOCK_REALTIME, microseconds, little-endian
+    uint8_t data[REL_DATA_SIZE];   // Data message exactly as received from the relay
+};
+#pragma pack(pop)
+
+#endif // TINKLARELAYRECORDING_H
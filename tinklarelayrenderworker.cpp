@@ -0,0 +1,423 @@
+// Includes
+#include <QFontMetrics>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <cstdlib>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "tinklarelayalloccheck.h"
+#include "tinklarelayenergygauge.h"
+#include "tinklarelayrenderworker.h"
+#include "tinklarelaytrace.h"
+
+// Abandoned jobs in a row before one is published anyway
+const int MAX_STALE_RESTARTS = 3;
+
+TinklaRelayRenderWorker::TinklaRelayRenderWorker(QObject *parent) :
+    QThread(parent),
+    hasPending_(false),
+    rendering_(false),
+    stopRequested_(false),
+    readyMask_(0),
+    readySourceNs_(0),
+    latestGeneration_(0),
+    flipH_(false),
+    flipV_(false)
+{
+    pending_.layers = 0;
+    pending_.pwrUsed = 0;
+    pending_.pwrAvailable = 0;
+    pending_.sourceNs = 0;
+    energyGeometry_.centerX = 0;
+    energyGeometry_.centerY = 0;
+    energyGeometry_.radius = 0;
+    energyGeometry_.qrtrVal = 1;
+    energyGeometry_.scale = 1.0;
+    for (int i = 0; i < NUM_LAYERS; ++i) {
+        layers_[i].back = 0;
+        layers_[i].ready = 1;
+        layers_[i].shown = 2;
+        layers_[i].digitMargin = 0;
+        layers_[i].lineHeight = 0;
+    }
+    //the worker's wake-up call, a queued signal would allocate an event per frame
+    readyFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    readyNotifier_ = new QSocketNotifier(readyFd_, QSocketNotifier::Read, this);
+    connect(readyNotifier_, SIGNAL(activated(int)), this, SLOT(readyFdActivated()));
+}
+
+TinklaRelayRenderWorker::~TinklaRelayRenderWorker()
+{
+    stop();
+    delete readyNotifier_;
+    ::close(readyFd_);
+}
+
+void TinklaRelayRenderWorker::stop()
+{
+    {
+        QMutexLocker locker(&mutex_);
+        stopRequested_ = true;
+        wake_.wakeOne();
+    }
+    wait();
+}
+
+void TinklaRelayRenderWorker::setFlip(bool flipH, bool flipV)
+{
+    QMutexLocker locker(&mutex_);
+    flipH_ = flipH;
+    flipV_ = flipV;
+}
+
+void TinklaRelayRenderWorker::beginPainters(Layer layer, const QSize &size)
+{
+    LayerConfig &config = layers_[layer];
+    for (int i = 0; i < 3; ++i) {
+        if (config.painters[i].isActive()) {
+            config.painters[i].end();
+        }
+        config.buffers[i] = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        config.buffers[i].fill(Qt::transparent);
+        config.painters[i].begin(&config.buffers[i]);
+        config.painters[i].setRenderHint(QPainter::Antialiasing);
+    }
+}
+
+// Digits are drawn once here, a number is then only a few image blits
+void TinklaRelayRenderWorker::configureText(Layer layer, const QSize &size, const QFont &font, const QColor &color)
+{
+    QMutexLocker locker(&mutex_);
+    LayerConfig &config = layers_[layer];
+    config.font = font;
+    config.color = color;
+    beginPainters(layer, size);
+    QFontMetrics fm(font, &config.buffers[0]);
+    config.lineHeight = fm.height();
+    config.digitMargin = fm.height() / 4;   // Room for glyphs that reach past their advance
+    for (int d = 0; d < 10; ++d) {
+        QChar digit('0' + d);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        config.digitAdvance[d] = fm.horizontalAdvance(digit);
+#else
+        config.digitAdvance[d] = fm.width(digit);
+#endif
+        QImage glyph(config.digitAdvance[d] + 2 * config.digitMargin, config.lineHeight, QImage::Format_ARGB32_Premultiplied);
+        glyph.fill(Qt::transparent);
+        QPainter p(&glyph);
+        p.setPen(color);
+        p.setFont(font);
+        p.drawText(config.digitMargin, fm.ascent(), QString(digit));
+        p.end();
+        config.digits[d] = glyph.mirrored(flipH_, flipV_);
+    }
+}
+
+void TinklaRelayRenderWorker::configureEnergy(const QSize &size, const EnergyGeometry &geometry)
+{
+    QMutexLocker locker(&mutex_);
+    energyGeometry_ = geometry;
+    beginPainters(LAYER_ENERGY, size);
+    powerPen_.setColor("orange");
+    powerPen_.setWidth(qRound(15 * geometry.scale));
+    powerPen_.setJoinStyle(Qt::RoundJoin);
+    regenPen_ = powerPen_;
+    regenPen_.setColor(Qt::green);
+    batteryPen_ = regenPen_;
+    batteryLowPen_ = powerPen_;
+    batteryEmptyPen_ = powerPen_;
+    batteryEmptyPen_.setColor("red");
+    markerPen_ = powerPen_;
+    markerPen_.setColor("white");
+    markerPen_.setWidth(qMax(1, qRound(4 * geometry.scale)));
+}
+
+void TinklaRelayRenderWorker::submit(const Job &job)
+{
+    QMutexLocker locker(&mutex_);
+    //values are always the latest, layers still owed by an older job are kept
+    quint32 owed = hasPending_ ? pending_.layers : 0;
+    pending_ = job;
+    pending_.layers |= owed;
+    hasPending_ = true;
+    latestGeneration_.fetch_add(1, std::memory_order_release);
+    wake_.wakeOne();
+}
+
+void TinklaRelayRenderWorker::run()
+{
+    TinklaRelayTrace::setThreadName("render");
+    QMutexLocker locker(&mutex_);
+    while (!stopRequested_) {
+        if (!hasPending_) {
+            wake_.wait(&mutex_);
+            continue;
+        }
+        locker.unlock();
+        renderPending();
+        locker.relock();
+    }
+}
+
+void TinklaRelayRenderWorker::renderPending()
+{
+    int restarts = 0;
+    forever {
+        Job job;
+        quint64 generation;
+        {
+            QMutexLocker locker(&mutex_);
+            if (!hasPending_ || stopRequested_) {
+                rendering_ = false;
+                return;
+            }
+            job = pending_;
+            hasPending_ = false;
+            rendering_ = true;
+            generation = latestGeneration_.load(std::memory_order_acquire);
+        }
+        TINKLA_ALLOC_FRAME("renderPending");
+        quint32 done = 0;
+        bool stale = false;
+        for (int layer = 0; layer < NUM_LAYERS && !stale; ++layer) {
+            if ((job.layers & (1u << layer)) == 0) {
+                continue;
+            }
+            QPainter &painter = layers_[layer].painters[layers_[layer].back];
+            if (layer == LAYER_ENERGY) {
+                drawEnergy(painter, job.pwrUsed, job.pwrAvailable);
+            } else {
+                drawText(painter, static_cast<Layer>(layer), job.text[layer]);
+            }
+            done |= 1u << layer;
+            stale = restarts < MAX_STALE_RESTARTS && latestGeneration_.load(std::memory_order_acquire) != generation;
+        }
+        QMutexLocker locker(&mutex_);
+        if (stale) {
+            //newer values arrived mid-job, redo everything with those instead of publishing old ones
+            pending_.layers |= job.layers;
+            ++restarts;
+            continue;
+        }
+        restarts = 0;
+        for (int layer = 0; layer < NUM_LAYERS; ++layer) {
+            if (done & (1u << layer)) {
+                qSwap(layers_[layer].back, layers_[layer].ready);
+            }
+        }
+        bool notify = readyMask_ == 0;
+        readyMask_ |= done;
+        if (done != 0) {
+            readySourceNs_ = job.sourceNs;
+        }
+        if (notify && done != 0) {
+            const quint64 one = 1;
+            if (::write(readyFd_, &one, sizeof(one)) != sizeof(one)) {
+                //only fails when the counter is already pending, the GUI thread is woken either way
+            }
+        }
+    }
+}
+
+// GUI thread
+void TinklaRelayRenderWorker::readyFdActivated()
+{
+    quint64 count;
+    if (::read(readyFd_, &count, sizeof(count)) == sizeof(count)) {
+        emit frameReady();
+    }
+}
+
+quint32 TinklaRelayRenderWorker::takeFinished(const QImage *(&images)[NUM_LAYERS], quint64 *sourceNs)
+{
+    QMutexLocker locker(&mutex_);
+    quint32 mask = readyMask_;
+    for (int layer = 0; layer < NUM_LAYERS; ++layer) {
+        if (mask & (1u << layer)) {
+            //the previously shown buffer goes back to the worker, the GUI thread no longer paints it
+            qSwap(layers_[layer].ready, layers_[layer].shown);
+            images[layer] = &layers_[layer].buffers[layers_[layer].shown];
+        }
+    }
+    readyMask_ = 0;
+    if (sourceNs != nullptr) {
+        *sourceNs = readySourceNs_;
+    }
+    return mask;
+}
+
+bool TinklaRelayRenderWorker::idle()
+{
+    QMutexLocker locker(&mutex_);
+    return !hasPending_ && !rendering_ && readyMask_ == 0;
+}
+
+// Arcs are polylines over the integer gauge tables, QPainter::drawArc builds a new QPainterPath every call
+void TinklaRelayRenderWorker::drawArc(QPainter &painter, const QPen &pen, int startDeg, int spanDeg)
+{
+    if (spanDeg == 0) {
+        return;
+    }
+    const int steps = qMin(std::abs(spanDeg), ARC_POINTS - 2);
+    const int step = spanDeg > 0 ? 1 : -1;
+    const qreal radius = qreal(energyGeometry_.radius) / (1 << TinklaRelayEnergyGauge::TRIG_SHIFT);
+    for (int i = 0; i <= steps; ++i) {
+        int deg = startDeg + i * step;
+        arcPoints_[i] = QPointF(energyGeometry_.centerX + radius * TinklaRelayEnergyGauge::cosQ(deg),
+                                energyGeometry_.centerY - radius * TinklaRelayEnergyGauge::sinQ(deg));
+    }
+    painter.setPen(pen);
+    painter.drawPolyline(arcPoints_, steps + 1);
+}
+
+void TinklaRelayRenderWorker::drawEnergy(QPainter &painter, int pwrUsed, int pwrAvailable) {
+   TINKLA_TRACE_SPAN("renderEnergy");
+   const int center_x = energyGeometry_.centerX;
+   const int center_y = energyGeometry_.centerY;
+   const int engRad = energyGeometry_.radius;
+   const int qrtrVal = energyGeometry_.qrtrVal;
+   const qreal scale = energyGeometry_.scale;
+   const int markerInset = qRound(10 * scale);
+    //rescale energy
+   int engScaled = TinklaRelayEnergyGauge::gaugeValue(pwrUsed);
+   //compute ccenter angles, whole degrees
+   int centerAngleDeg = (90 * engScaled / qrtrVal);
+   int centerAngleDegBatt = (90 * pwrAvailable / qrtrVal);
+   int angleSign = 1;
+   if (centerAngleDeg != 0) {
+       angleSign = centerAngleDeg > 0 ? 1 : -1;
+   }
+   if (std::abs(centerAngleDeg) <= 2) {
+       angleSign = 0;
+   }
+   if (centerAngleDegBatt > 2) {
+       centerAngleDegBatt = centerAngleDegBatt - 2 ;
+   }
+   centerAngleDeg = centerAngleDeg - 2 * angleSign;
+   //clear the drawing area
+   painter.setCompositionMode(QPainter::CompositionMode_Source);
+   painter.fillRect(0, 0, painter.device()->width(), painter.device()->height(), Qt::transparent);
+   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+   //now draw
+   int startAngle = 0;
+   int startAngleBatt = 180 + 90 * 60/qrtrVal; //60% is at 180 deg
+   if (flipH_) {
+       startAngle = (180 - startAngle);
+       startAngleBatt = (180 - startAngleBatt);
+   }
+   if (flipV_) {
+       startAngleBatt = (360 - startAngleBatt);
+   }
+   int spanAngle = centerAngleDeg;
+   int spanAngleBatt = -centerAngleDegBatt;
+   if ((flipH_ != flipV_) && (flipH_ || flipV_)) {
+       spanAngle = - spanAngle;
+       spanAngleBatt = -spanAngleBatt;
+   }
+   drawArc(painter, pwrUsed < 0 ? regenPen_ : powerPen_, startAngle, spanAngle);
+   const QPen &batteryPen = pwrAvailable <= 5 ? batteryEmptyPen_ : (pwrAvailable <= 20 ? batteryLowPen_ : batteryPen_);
+   drawArc(painter, batteryPen, startAngleBatt, spanAngleBatt);
+   //compute power marker
+   int x = TinklaRelayEnergyGauge::projectX(engRad - markerInset, centerAngleDeg + 1 * angleSign);
+   int y = TinklaRelayEnergyGauge::projectY(engRad - markerInset, centerAngleDeg + 1 * angleSign);
+   int lineAngle = centerAngleDeg;
+   int bx = TinklaRelayEnergyGauge::projectX(engRad - markerInset, 180 + 90 * 60/qrtrVal - centerAngleDegBatt - 1);
+   int by = TinklaRelayEnergyGauge::projectY(engRad - markerInset, 180 + 90 * 60/qrtrVal - centerAngleDegBatt - 1);
+   int lineAngleBatt = 180 + 90 * 60/qrtrVal - centerAngleDegBatt;
+   //flip markers
+   if (flipH_) {
+       x = -x;
+       bx = -bx;
+       lineAngle = 180 - lineAngle;
+       lineAngleBatt = 180 - lineAngleBatt;
+   }
+   if (flipV_) {
+       y = -y;
+       by = - by;
+       lineAngle = -lineAngle;
+       lineAngleBatt = - lineAngleBatt;
+   }
+   //draw markers
+   painter.setPen(markerPen_);
+   QLineF marker;
+   marker.setP1(QPointF(center_x+x,center_y-y));
+   marker.setAngle(lineAngle);
+   marker.setLength(25 * scale);
+   painter.drawLine(marker);
+   QLineF markerBatt;
+   markerBatt.setP1(QPointF(center_x+bx,center_y-by));
+   markerBatt.setAngle(lineAngleBatt);
+   markerBatt.setLength(25 * scale);
+   painter.drawLine(markerBatt);
+}
+
+// Numbers use the pre-mirrored digits, any other text is mirrored by the painter itself
+void TinklaRelayRenderWorker::drawText(QPainter &painter, Layer layer, const QString &text) {
+    TINKLA_TRACE_SPAN("renderText");
+    const LayerConfig &config = layers_[layer];
+    const int width = painter.device()->width();
+    const int height = painter.device()->height();
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(0, 0, width, height, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    //numbers, the steady case, are put together from the digit images and centered like drawText() does
+    int textWidth = 0;
+    bool digitsOnly = !text.isEmpty();
+    for (int i = 0; i < text.size() && digitsOnly; ++i) {
+        ushort c = text.at(i).unicode();
+        digitsOnly = c >= '0' && c <= '9';
+        if (digitsOnly) {
+            textWidth += config.digitAdvance[c - '0'];
+        }
+    }
+    if (digitsOnly) {
+        int x = (width - textWidth) / 2;
+        const int y = flipV_ ? height - (height - config.lineHeight) / 2 - config.lineHeight : (height - config.lineHeight) / 2;
+        for (int i = 0; i < text.size(); ++i) {
+            const int d = text.at(i).unicode() - '0';
+            const int gx = flipH_ ? width - x - config.digitAdvance[d] : x;
+            painter.drawImage(gx - config.digitMargin, y, config.digits[d]);
+            x += config.digitAdvance[d];
+        }
+        return;
+    }
+    painter.save();
+    if (flipH_) {
+        painter.translate(width, 0);
+        painter.scale(-1, 1);
+    }
+    if (flipV_) {
+        painter.translate(0, height);
+        painter.scale(1, -1);
+    }
+    painter.setPen(config.color);
+    painter.setFont(config.font);
+    painter.drawText(QRectF(0, 0, width, height), Qt::AlignVCenter | Qt::AlignHCenter, text);
+    painter.restore();
+}
+
+TinklaRelayLayerView::TinklaRelayLayerView(QWidget *parent) :
+    QWidget(parent),
+    image_(nullptr)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+void TinklaRelayLayerView::setImage(const QImage *image)
+{
+    image_ = image;
+    update();
+}
+
+const QImage *TinklaRelayLayerView::image() const
+{
+    return image_;
+}
+
+void TinklaRelayLayerView::paintEvent(QPaintEvent *)
+{
+    if (image_ != nullptr) {
+        QPainter p(this);
+        p.drawImage(0, 0, *image_);
+    }
+}
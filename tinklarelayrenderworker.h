@@ -0,0 +1,135 @@
+#ifndef TINKLARELAYRENDERWORKER_H
+#define TINKLARELAYRENDERWORKER_H
+
+// Includes
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QPainter>
+#include <QPen>
+#include <QFont>
+#include <QWidget>
+#include <QColor>
+#include <QString>
+#include <atomic>
+
+class QSocketNotifier;
+
+// Rasterizes the dynamic HUD layers (energy gauge and text values) on a worker thread
+// The GUI thread submits the latest values, the worker paints into the back buffer of each layer,
+// and the GUI thread only takes over the finished images when frameReady() fires. Each layer has three buffers
+// (painted, ready, shown) that change roles by index, so handing an image over never copies it.
+// A job that has not finished when a newer one arrives is abandoned and its layers are redone with the newer values,
+// at most MAX_STALE_RESTARTS times in a row so that values changing faster than a job renders still get published.
+// Nothing on the way allocates once the thread runs: submit() wakes the worker through a wait condition, the worker
+// signals back through an eventfd, every buffer keeps its painter and numbers are put together from digit images
+class TinklaRelayRenderWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Layer {
+        LAYER_ENERGY = 0,
+        LAYER_SPEED,
+        LAYER_SPEED_LIMIT,
+        LAYER_ACC_SPEED,
+        LAYER_SPLASH_TEXT,
+        NUM_LAYERS
+    };
+    struct EnergyGeometry {
+        int centerX;
+        int centerY;
+        int radius;
+        int qrtrVal;   // Gauge value at 90 degrees
+        qreal scale;   // Screen size relative to the 800x480 design, for line widths
+    };
+    struct Job {
+        quint32 layers;             // Bitmask of (1 << Layer) to render
+        int pwrUsed;
+        int pwrAvailable;
+        quint64 sourceNs;           // TinklaRelayTrace::nowNs() when the shown relay data was decoded, 0 if none
+        QString text[NUM_LAYERS];   // For the text layers
+    };
+
+    explicit TinklaRelayRenderWorker(QObject *parent = nullptr);   // Construct on the GUI thread
+    ~TinklaRelayRenderWorker();
+
+    // Setup on the GUI thread before start(), setFlip() first
+    void setFlip(bool flipH, bool flipV);
+    void configureText(Layer layer, const QSize &size, const QFont &font, const QColor &color);
+    void configureEnergy(const QSize &size, const EnergyGeometry &geometry);
+
+    void submit(const Job &job);                        // Any thread, never blocks on rendering
+    // GUI thread, returns the mask of layers with a new image and points images[layer] at it. The worker leaves
+    // that image alone until the next takeFinished(). sourceNs gets the newest finished job's sourceNs
+    quint32 takeFinished(const QImage *(&images)[NUM_LAYERS], quint64 *sourceNs = nullptr);
+    bool idle();   // Nothing submitted that is not rendered and taken yet
+    void stop();
+signals:
+    void frameReady();
+protected:
+    void run() override;
+private slots:
+    void readyFdActivated();
+private:
+    static const int ARC_POINTS = 362;   // One per degree of a full turn, both ends included
+    struct LayerConfig {
+        QFont font;
+        QColor color;
+        QImage buffers[3];
+        QPainter painters[3];   // Kept active for the life of the buffer, after the images so they end first
+        int back;    // Being painted by the worker
+        int ready;   // Finished, not taken yet
+        int shown;   // Taken by the GUI thread
+        QImage digits[10];      // Pre-mirrored glyphs, advance wide plus a margin on both sides
+        int digitAdvance[10];
+        int digitMargin;
+        int lineHeight;
+    };
+    QMutex mutex_;
+    QWaitCondition wake_;
+    Job pending_;
+    bool hasPending_;
+    bool rendering_;
+    bool stopRequested_;
+    quint32 readyMask_;
+    quint64 readySourceNs_;
+    std::atomic<quint64> latestGeneration_;
+    int readyFd_;
+    QSocketNotifier *readyNotifier_;
+    LayerConfig layers_[NUM_LAYERS];
+    EnergyGeometry energyGeometry_;
+    QPen powerPen_;      // Orange, green while regenerating
+    QPen regenPen_;
+    QPen batteryPen_;    // Green, orange and red as the battery runs low
+    QPen batteryLowPen_;
+    QPen batteryEmptyPen_;
+    QPen markerPen_;
+    QPointF arcPoints_[ARC_POINTS];
+    bool flipH_;
+    bool flipV_;
+
+    void renderPending();
+    void beginPainters(Layer layer, const QSize &size);
+    void drawArc(QPainter &painter, const QPen &pen, int startDeg, int spanDeg);
+    void drawEnergy(QPainter &painter, int pwrUsed, int pwrAvailable);
+    void drawText(QPainter &painter, Layer layer, const QString &text);
+};
+
+// Shows one rendered layer on top of its label, straight from the worker's buffer
+class TinklaRelayLayerView : public QWidget
+{
+public:
+    explicit TinklaRelayLayerView(QWidget *parent = nullptr);
+    void setImage(const QImage *image);   // Not copied, must stay valid until replaced
+    const QImage *image() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    const QImage *image_;
+};
+
+#endif // TINKLARELAYRENDERWORKER_H
@@ -0,0 +1,52 @@
+// Includes
+#include "tinklarelayscreenmode.h"
+
+TinklaRelayScreenMode::TinklaRelayScreenMode() :
+    connected_(false),
+    stale_(false),
+    graceEndMs_(0)
+{
+}
+
+void TinklaRelayScreenMode::warmStarted(uint64_t nowMs)
+{
+    stale_ = true;
+    graceEndMs_ = nowMs + WARM_START_GRACE_MS;
+}
+
+void TinklaRelayScreenMode::connectionChanged(bool connected, uint64_t nowMs)
+{
+    connected_ = connected;
+    //a relay that connects but is slow with its first message keeps the gauges, the grace only covers searching
+    tick(nowMs);
+}
+
+void TinklaRelayScreenMode::freshData()
+{
+    stale_ = false;
+}
+
+void TinklaRelayScreenMode::tick(uint64_t nowMs)
+{
+    if (stale_ && !connected_ && nowMs >= graceEndMs_) {
+        stale_ = false;
+    }
+}
+
+TinklaRelayScreenMode::Screen TinklaRelayScreenMode::screen() const
+{
+    if (connected_) {
+        return SCREEN_LIVE;
+    }
+    return stale_ ? SCREEN_SNAPSHOT : SCREEN_SPINNER;
+}
+
+bool TinklaRelayScreenMode::stale() const
+{
+    return stale_;
+}
+
+int64_t TinklaRelayScreenMode::graceLeftMs(uint64_t nowMs) const
+{
+    return nowMs >= graceEndMs_ ? 0 : static_cast<int64_t>(graceEndMs_ - nowMs);
+}
@@ -0,0 +1,36 @@
+#ifndef TINKLARELAYSCREENMODE_H
+#define TINKLARELAYSCREENMODE_H
+
+// Includes
+#include <stdint.h>
+
+// Decides what the HUD shows: the spinner while searching for the relay, the gauges while it is connected,
+// and after a warm start the dimmed snapshot until the relay answers or a grace period runs out.
+// Plain C++ on a caller-supplied millisecond clock, so the fault-injection soak steps the same decisions as the HUD
+class TinklaRelayScreenMode
+{
+public:
+    enum Screen {
+        SCREEN_SPINNER,     // Searching for the relay
+        SCREEN_SNAPSHOT,    // Warm-start snapshot, the relay has not answered yet
+        SCREEN_LIVE         // Relay connected, gauges updating
+    };
+    static const int WARM_START_GRACE_MS = 5000;  // How long the snapshot stands in for a relay that does not answer
+
+    TinklaRelayScreenMode();
+
+    void warmStarted(uint64_t nowMs);                       // The snapshot is on screen
+    void connectionChanged(bool connected, uint64_t nowMs);
+    void freshData();                                       // A data message was decoded
+    void tick(uint64_t nowMs);                              // Ends the grace period once it has run out
+
+    Screen screen() const;
+    bool stale() const;                     // Still showing snapshot data, dimmed
+    int64_t graceLeftMs(uint64_t nowMs) const;  // Until tick() drops the snapshot, only meaningful on SCREEN_SNAPSHOT
+private:
+    bool connected_;
+    bool stale_;
+    uint64_t graceEndMs_;
+};
+
+#endif // TINKLARELAYSCREENMODE_H
@@ -0,0 +1,98 @@
+// Includes
+#include <new>
+#include <sys/stat.h>
+#include "tinklarelayshm.h"
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "the sequence word must be a plain 32-bit word to be usable as a futex");
+
+TinklaRelayShmPublisher::TinklaRelayShmPublisher() :
+    segment_(nullptr)
+{
+}
+
+TinklaRelayShmPublisher::~TinklaRelayShmPublisher()
+{
+    if (segment_ != nullptr) {
+        setConnected(false);
+        munmap(segment_, sizeof(TinklaRelayShmSegment));
+    }
+}
+
+bool TinklaRelayShmPublisher::open(const char *name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);  // Readable by non-root readers even under a restrictive umask
+    if (ftruncate(fd, sizeof(TinklaRelayShmSegment)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, sizeof(TinklaRelayShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    segment_ = static_cast<TinklaRelayShmSegment *>(map);
+    if (segment_->magic != REL_SHM_MAGIC || segment_->version != REL_SHM_VERSION) {
+        //fresh segment (or one from an incompatible build), lay it out from scratch
+        memset(static_cast<void *>(segment_), 0, sizeof(TinklaRelayShmSegment));
+        new (&segment_->state) TinklaRelayState();
+        segment_->version = REL_SHM_VERSION;
+        segment_->magic = REL_SHM_MAGIC;
+    } else if (segment_->seq.load(std::memory_order_relaxed) & 1u) {
+        //previous writer died mid-update
+        segment_->seq.fetch_add(1, std::memory_order_release);
+    }
+    return true;
+}
+
+bool TinklaRelayShmPublisher::isOpen() const
+{
+    return segment_ != nullptr;
+}
+
+void TinklaRelayShmPublisher::beginWrite()
+{
+    segment_->seq.fetch_add(1, std::memory_order_relaxed);  // Now odd
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void TinklaRelayShmPublisher::endWrite()
+{
+    segment_->seq.fetch_add(1, std::memory_order_release);  // Even again
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&segment_->seq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void TinklaRelayShmPublisher::publish(uint64_t timestampUs, const uint8_t *data, const TinklaRelayState &state)
+{
+    if (segment_ == nullptr) {
+        return;
+    }
+    beginWrite();
+    segment_->frames++;
+    segment_->timestampUs = timestampUs;
+    segment_->connected = 1;
+    memcpy(segment_->data, data, REL_DATA_SIZE);
+    memcpy(static_cast<void *>(&segment_->state), &state, sizeof(TinklaRelayState));
+    endWrite();
+}
+
+void TinklaRelayShmPublisher::setConnected(bool connected)
+{
+    if (segment_ == nullptr || (segment_->connected != 0) == connected) {
+        return;
+    }
+    beginWrite();
+    segment_->connected = connected ? 1 : 0;
+    endWrite();
+}
+
+uint64_t TinklaRelayShmPublisher::realtimeUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
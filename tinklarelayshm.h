@@ -0,0 +1,160 @@
+#ifndef TINKLARELAYSHM_H
+#define TINKLARELAYSHM_H
+
+// Live vehicle state shared with other local processes through a /dev/shm segment
+// The HUD is the only writer. Any number of readers map the segment read-only, read it in place
+// under a seqlock and can block on the sequence word with a futex until the next frame arrives
+// This header is all a reader needs, it depends on nothing but tinklarelaystate.h and Linux
+
+// Includes
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "tinklarelaystate.h"
+
+#define REL_SHM_DEFAULT_NAME "/tinklaRelayHUD"
+#define REL_SHM_MAGIC 0x4d535254u   // "TRSM"
+#define REL_SHM_VERSION 1u
+
+// Segment layout. seq is odd while the writer is updating the rest
+struct TinklaRelayShmSegment {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> seq;     // Seqlock sequence, also the futex word readers wait on
+    uint32_t reserved;
+    uint64_t frames;               // Data messages published so far
+    uint64_t timestampUs;          // CLOCK_REALTIME of the last data message
+    uint8_t connected;             // 1 while the relay is connected
+    uint8_t data[REL_DATA_SIZE];   // Last data message exactly as received
+    TinklaRelayState state;        // Same message, decoded
+};
+
+// Consistent copy of the segment contents
+struct TinklaRelayShmSnapshot {
+    uint32_t seq;
+    uint64_t frames;
+    uint64_t timestampUs;
+    bool connected;
+    uint8_t data[REL_DATA_SIZE];
+    TinklaRelayState state;
+};
+
+class TinklaRelayShmReader
+{
+public:
+    static const int READ_RETRIES = 1000;   // An update takes well under a microsecond
+
+    TinklaRelayShmReader() : segment_(nullptr) {}
+    ~TinklaRelayShmReader() { close(); }
+
+    bool open(const char *name = REL_SHM_DEFAULT_NAME)
+    {
+        close();
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        void *map = mmap(nullptr, sizeof(TinklaRelayShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);  // The mapping keeps the segment alive
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        segment_ = static_cast<const TinklaRelayShmSegment *>(map);
+        if (segment_->magic != REL_SHM_MAGIC || segment_->version != REL_SHM_VERSION) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (segment_ != nullptr) {
+            munmap(const_cast<TinklaRelayShmSegment *>(segment_), sizeof(TinklaRelayShmSegment));
+            segment_ = nullptr;
+        }
+    }
+
+    bool isOpen() const { return segment_ != nullptr; }
+
+    uint32_t sequence() const { return segment_->seq.load(std::memory_order_acquire); }
+
+    // Copies the latest frame, retrying while the writer is in the middle of an update. Returns false after
+    // READ_RETRIES attempts, when a writer died mid-update or keeps overwriting; wait() for the next sequence then
+    bool read(TinklaRelayShmSnapshot &out) const
+    {
+        for (int attempt = 0; attempt < READ_RETRIES; ++attempt) {
+            uint32_t before = segment_->seq.load(std::memory_order_acquire);
+            if (before & 1u) {
+                continue;
+            }
+            out.frames = segment_->frames;
+            out.timestampUs = segment_->timestampUs;
+            out.connected = segment_->connected != 0;
+            memcpy(out.data, segment_->data, REL_DATA_SIZE);
+            memcpy(static_cast<void *>(&out.state), &segment_->state, sizeof(TinklaRelayState));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment_->seq.load(std::memory_order_relaxed) == before) {
+                out.seq = before;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Blocks until the sequence moves past lastSeq or timeoutMs expires (negative waits forever)
+    // Returns true if there is something new to read
+    bool wait(uint32_t lastSeq, int timeoutMs) const
+    {
+        //FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline, signals and spurious wakeups do not restart it
+        timespec deadline;
+        if (timeoutMs >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeoutMs / 1000;
+            deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000L;
+            }
+        }
+        while (sequence() == lastSeq) {
+            long r = syscall(SYS_futex, reinterpret_cast<const uint32_t *>(&segment_->seq), FUTEX_WAIT_BITSET, lastSeq,
+                             timeoutMs < 0 ? nullptr : &deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+            if (r != 0 && errno == ETIMEDOUT) {
+                return sequence() != lastSeq;
+            }
+        }
+        return true;
+    }
+private:
+    const TinklaRelayShmSegment *segment_;
+};
+
+// Writer side, used by the HUD and by headless mode
+class TinklaRelayShmPublisher
+{
+public:
+    TinklaRelayShmPublisher();
+    ~TinklaRelayShmPublisher();  // Marks the relay disconnected; the segment is kept so readers survive a restart
+
+    bool open(const char *name = REL_SHM_DEFAULT_NAME);
+    bool isOpen() const;
+    void publish(uint64_t timestampUs, const uint8_t *data, const TinklaRelayState &state);
+    void setConnected(bool connected);
+
+    static uint64_t realtimeUs();
+private:
+    TinklaRelayShmSegment *segment_;
+
+    void beginWrite();
+    void endWrite();
+};
+
+#endif // TINKLARELAYSHM_H
@@ -0,0 +1,44 @@
+// Includes
+#include "tinklarelaystate.h"
+
+void TinklaRelayState::decode(const uint8_t *data) {
+  rel_gear_in_neutral = ((data[0] & REL_GEAR_IN_NEUTRAL) > 0);
+  rel_option1_on = ((data[0] & REL_OPTION1_ON) > 0);
+  rel_option2_on = ((data[0] & REL_OPTION2_ON) > 0);
+  rel_option3_on = ((data[0] & REL_OPTION3_ON) > 0);
+  rel_option4_on = ((data[0] & REL_OPTION4_ON) > 0);
+  rel_car_on = ((data[0] & REL_CAR_ON) > 0);
+  rel_gear_in_reverse = ((data[0] & REL_GEAR_IN_REVERSE) > 0);
+  rel_gear_in_forward = ((data[0] & REL_GEAR_IN_FORWARD) > 0);
+
+  rel_brake_hold_on = ((data[1] & REL_BRAKE_HOLD) > 0);
+  rel_left_turn_signal = ((data[1] & REL_LEFT_TURN_SIGNAL) > 0);
+  rel_right_turn_signal = ((data[1] & REL_RIGHT_TURN_SIGNAL) > 0);
+  rel_brake_pressed = ((data[1] & REL_BRAKE_PRESSED) > 0);
+  rel_highbeams_on = ((data[1] & REL_HIGHBEAMS_ON) > 0);
+  rel_light_on = ((data[1] & REL_LIGHT_ON) > 0);
+  rel_below_20mph = ((data[1] & REL_BELOW_20MPH) > 0);
+  rel_use_imperial = ((data[1] & REL_USE_IMPERIAL_FOR_SPEED) > 0);
+
+  rel_tpms_alert_on = ((data[2] & REL_TPMS_ALERT_ON) > 0);
+  rel_left_steering_above_45deg = ((data[2] & REL_LEFT_STEERING_ANGLE_ABOVE_45DEG) > 0);
+  rel_right_steering_above_45deg = ((data[2] & REL_RIGHT_STEERING_ANGLE_ABOVE_45DEG) > 0);
+  rel_AP_on = ((data[2] & REL_AP_ON) > 0);
+  rel_car_charging = ((data[2] & REL_CAR_CHARGING) > 0);
+  rel_left_side_bsm = ((data[2] & REL_LEFT_SIDE_BSM) > 0);
+  rel_right_side_bsm = ((data[2] & REL_RIGHT_SIDE_BSM) > 0);
+  rel_tacc_only_active = ((data[2] & REL_TACC_ONLY_ACTIVE) > 0);
+
+  rel_brightness = data[3];
+
+  rel_speed = data[4];
+
+  rel_power_lvl = (int16_t)((data[5] << 8) | data[6]);
+
+  rel_acc_speed = data[7];
+
+  rel_speed_limit = 5 * (data[8] & 0x1F);
+  rel_acc_status = (data[8] >> 5) & 0x03;
+  rel_AP_available = ((data[8] & REL_AP_AVAILABLE) > 0);
+  rel_battery_lvl = data[9];
+}
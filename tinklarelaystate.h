@@ -0,0 +1,79 @@
+#ifndef TINKLARELAYSTATE_H
+#define TINKLARELAYSTATE_H
+
+// Includes
+#include <stdint.h>
+
+// Layout of the relay data message
+//First Byte After DATA
+#define REL_GEAR_IN_NEUTRAL 1
+#define REL_OPTION1_ON 2
+#define REL_OPTION2_ON 4
+#define REL_OPTION3_ON 8
+#define REL_OPTION4_ON 16
+#define REL_CAR_ON 32
+#define REL_GEAR_IN_REVERSE 64
+#define REL_GEAR_IN_FORWARD 128
+//Second Byte After DATA
+#define REL_BRAKE_HOLD 1
+#define REL_LEFT_TURN_SIGNAL 2
+#define REL_RIGHT_TURN_SIGNAL 4
+#define REL_BRAKE_PRESSED 8
+#define REL_HIGHBEAMS_ON 16
+#define REL_LIGHT_ON 32
+#define REL_BELOW_20MPH 64
+#define REL_USE_IMPERIAL_FOR_SPEED 128
+//Third Byte After DATA
+#define REL_TPMS_ALERT_ON 1
+#define REL_LEFT_STEERING_ANGLE_ABOVE_45DEG 2
+#define REL_RIGHT_STEERING_ANGLE_ABOVE_45DEG 4
+#define REL_AP_ON 8
+#define REL_CAR_CHARGING 16
+#define REL_LEFT_SIDE_BSM 32
+#define REL_RIGHT_SIDE_BSM 64
+#define REL_TACC_ONLY_ACTIVE 128
+//Eighth Byte adter DATA
+#define REL_AP_AVAILABLE 128
+//Size of the data message
+#define REL_DATA_SIZE 10
+
+// Decoded relay data message. Plain data without Qt so recordings can be decoded outside the HUD
+struct TinklaRelayState
+{
+    void decode(const uint8_t *data);  // data points to REL_DATA_SIZE bytes
+
+    bool rel_option1_on = false;
+    bool rel_option2_on = false;
+    bool rel_option3_on = false;
+    bool rel_option4_on = false;
+    bool rel_car_on = false;
+    bool rel_gear_in_reverse = false;
+    bool rel_gear_in_forward = false;
+    bool rel_gear_in_neutral = false;
+    bool rel_left_turn_signal = false;
+    bool rel_right_turn_signal = false;
+    bool rel_brake_pressed = false;
+    bool rel_highbeams_on = false;
+    bool rel_light_on = false;
+    bool rel_below_20mph = false; //BELOW 20 MPH
+    bool rel_left_steering_above_45deg = false; //MORE THAN 45 DEG
+    bool rel_right_steering_above_45deg = false; //MORE THAN 45 DEG
+    bool rel_AP_on = false; //start with true if only Veh can is connected
+    bool rel_car_charging = false;
+    bool rel_left_side_bsm = false;
+    bool rel_right_side_bsm = false;
+    bool rel_tacc_only_active = false;
+    bool rel_use_imperial = false; //imperial vs metric for speed
+    bool rel_brake_hold_on = false;
+    bool rel_tpms_alert_on = false;
+    uint8_t rel_brightness = 100; // start brightness value
+    uint8_t rel_speed = 0; //starting speed, speed is in the UoM set on car
+    int16_t rel_power_lvl = 0;
+    bool rel_AP_available = false;
+    uint8_t rel_acc_status = 0;
+    uint8_t rel_acc_speed = 0;
+    uint8_t rel_speed_limit = 0;
+    uint8_t rel_battery_lvl = 0;
+};
+
+#endif // TINKLARELAYSTATE_H
@@ -0,0 +1,214 @@
+// Includes
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tinklarelaystream.h"
+#include "tinklarelayconnection.h"
+#include "tinklarelayshm.h"
+
+// Worst case size of one JSON line, the buffer is flushed before it could overflow
+const int JSON_LINE_MAX = 768;
+
+// Retry period while the relay is not connected, same as the HUD's USB timer
+const int SEARCH_INTERVAL_MS = 200;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+static uint64_t realtimeUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+// Flush intervals, record timestamps stay on the wall clock
+static uint64_t monotonicUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+static void sleepMs(int ms)
+{
+    timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = static_cast<long>(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR && !stopRequested) {
+    }
+}
+
+TinklaRelayStreamWriter::TinklaRelayStreamWriter(int fd, Format format, int flushIntervalMs) :
+    fd_(fd),
+    format_(format),
+    flushIntervalUs_(static_cast<uint64_t>(flushIntervalMs) * 1000),
+    lastFlushUs_(monotonicUs()),
+    blockStartedUs_(0),
+    used_(0),
+    failed_(false)
+{
+    if (format_ == FORMAT_BINARY) {
+        memcpy(buffer_, REL_RECORDING_MAGIC, REL_RECORDING_MAGIC_LEN);
+        used_ = REL_RECORDING_MAGIC_LEN;
+    }
+    if (format_ == FORMAT_COLUMNAR) {
+        columnar_.reset(new TinklaRelayColumnarWriter(fd_));
+    }
+}
+
+TinklaRelayStreamWriter::~TinklaRelayStreamWriter()
+{
+    if (columnar_) {
+        columnar_->finish();
+    } else {
+        flush();
+    }
+}
+
+bool TinklaRelayStreamWriter::append(uint64_t timestampUs, const uint8_t *data, const TinklaRelayState &state)
+{
+    if (columnar_) {
+        if (columnar_->pendingSinceUs() == 0) {
+            blockStartedUs_ = monotonicUs();
+        }
+        columnar_->append(timestampUs, data);
+        return flushIfDue();
+    }
+    int needed = format_ == FORMAT_BINARY ? static_cast<int>(sizeof(TinklaRelayRecord)) : JSON_LINE_MAX;
+    if (BUFFER_SIZE - used_ < needed && !flush()) {
+        return false;
+    }
+    if (format_ == FORMAT_BINARY) {
+        TinklaRelayRecord record;
+        record.timestampUs = timestampUs;
+        memcpy(record.data, data, REL_DATA_SIZE);
+        memcpy(buffer_ + used_, &record, sizeof(record));
+        used_ += static_cast<int>(sizeof(record));
+    } else {
+        int n = snprintf(buffer_ + used_, static_cast<size_t>(BUFFER_SIZE - used_),
+            "{\"t\":%llu,\"car_on\":%d,\"gear_reverse\":%d,\"gear_forward\":%d,\"gear_neutral\":%d,"
+            "\"left_turn_signal\":%d,\"right_turn_signal\":%d,\"brake_pressed\":%d,\"brake_hold\":%d,"
+            "\"highbeams_on\":%d,\"lights_on\":%d,\"below_20mph\":%d,\"use_imperial\":%d,"
+            "\"tpms_alert\":%d,\"left_steering_above_45deg\":%d,\"right_steering_above_45deg\":%d,"
+            "\"ap_on\":%d,\"ap_available\":%d,\"tacc_only_active\":%d,\"car_charging\":%d,"
+            "\"left_bsm\":%d,\"right_bsm\":%d,\"option1\":%d,\"option2\":%d,\"option3\":%d,\"option4\":%d,"
+            "\"brightness\":%u,\"speed\":%u,\"power\":%d,\"battery\":%u,"
+            "\"acc_status\":%u,\"acc_speed\":%u,\"speed_limit\":%u}\n",
+            static_cast<unsigned long long>(timestampUs), state.rel_car_on, state.rel_gear_in_reverse, state.rel_gear_in_forward, state.rel_gear_in_neutral,
+            state.rel_left_turn_signal, state.rel_right_turn_signal, state.rel_brake_pressed, state.rel_brake_hold_on,
+            state.rel_highbeams_on, state.rel_light_on, state.rel_below_20mph, state.rel_use_imperial,
+            state.rel_tpms_alert_on, state.rel_left_steering_above_45deg, state.rel_right_steering_above_45deg,
+            state.rel_AP_on, state.rel_AP_available, state.rel_tacc_only_active, state.rel_car_charging,
+            state.rel_left_side_bsm, state.rel_right_side_bsm, state.rel_option1_on, state.rel_option2_on, state.rel_option3_on, state.rel_option4_on,
+            state.rel_brightness, state.rel_speed, state.rel_power_lvl, state.rel_battery_lvl,
+            state.rel_acc_status, state.rel_acc_speed, state.rel_speed_limit);
+        if (n > 0 && n < BUFFER_SIZE - used_) {
+            used_ += n;
+        }
+    }
+    return flushIfDue();
+}
+
+bool TinklaRelayStreamWriter::flushIfDue()
+{
+    uint64_t nowUs = monotonicUs();
+    if (columnar_) {
+        //age of the block rather than of the last flush, a block only ever goes out once
+        if (columnar_->pendingSinceUs() != 0 && nowUs - blockStartedUs_ >= flushIntervalUs_) {
+            return columnar_->flushBlock();
+        }
+        return !columnar_->failed();
+    }
+    if (nowUs - lastFlushUs_ >= flushIntervalUs_) {
+        return flush();
+    }
+    return !failed_;
+}
+
+bool TinklaRelayStreamWriter::flush()
+{
+    if (columnar_) {
+        return columnar_->flushBlock();
+    }
+    lastFlushUs_ = monotonicUs();
+    int offset = 0;
+    while (offset < used_ && !failed_) {
+        ssize_t written = write(fd_, buffer_ + offset, static_cast<size_t>(used_ - offset));
+        if (written > 0) {
+            offset += static_cast<int>(written);
+        } else if (written < 0 && errno != EINTR) {
+            failed_ = true;
+        }
+    }
+    used_ = 0;
+    return !failed_;
+}
+
+bool TinklaRelayStreamWriter::failed() const
+{
+    return columnar_ ? columnar_->failed() : failed_;
+}
+
+int tinklaRelayRunHeadless(const TinklaRelayHeadlessOptions &options)
+{
+    int fd = STDOUT_FILENO;
+    if (options.output != "-") {
+        fd = open(options.output.toLocal8Bit().constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);  // Blocks until a reader shows up on a FIFO
+        if (fd < 0) {
+            fprintf(stderr, "Cannot open %s: %s\n", qPrintable(options.output), strerror(errno));
+            return 1;
+        }
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);  // A reader going away shows up as EPIPE from write()
+
+    int result = 0;
+    {
+        TinklaRelayDriver driver;
+        TinklaRelayConnection connection(driver);
+        TinklaRelayStreamWriter writer(fd, options.format, options.flushIntervalMs);
+        TinklaRelayShmPublisher publisher;
+        if (!options.shmName.isEmpty()) {
+            publisher.open(options.shmName.toLocal8Bit().constData());
+        }
+        while (!stopRequested) {
+            bool gotData = false;
+            if (connection.poll(&gotData) == TinklaRelayConnection::EVENT_DISCONNECTED) {
+                publisher.setConnected(false);
+            }
+            if (gotData) {
+                uint64_t now = realtimeUs();
+                writer.append(now, driver.rawData(), driver.state);
+                publisher.publish(now, driver.rawData(), driver.state);
+            } else {
+                writer.flushIfDue();
+            }
+            if (writer.failed()) {
+                result = 1;
+                break;
+            }
+            if (!connection.connected()) {
+                sleepMs(SEARCH_INTERVAL_MS);
+            } else if (options.intervalMs > 0) {
+                sleepMs(options.intervalMs);
+            }
+        }
+    }
+    if (fd != STDOUT_FILENO) {
+        close(fd);
+    }
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef TINKLARELAYSTREAM_H
+#define TINKLARELAYSTREAM_H
+
+// Includes
+#include <QString>
+#include <memory>
+#include <stdint.h>
+#include "tinklarelayrecording.h"
+#include "tinklarelaycolumnar.h"
+
+// Buffers decoded frames and writes them in batches, so a fast acquisition loop costs one
+// write() per buffer or per flush interval rather than one per frame. Never allocates after construction,
+// except for one columnar index entry per block
+class TinklaRelayStreamWriter
+{
+public:
+    enum Format {
+        FORMAT_BINARY,   // REL_RECORDING_MAGIC followed by TinklaRelayRecord
+        FORMAT_JSON,     // One JSON object per line
+        FORMAT_COLUMNAR  // Compressed blocks, see tinklarelaycolumnar.h. A block is written when full or flushed
+    };
+    static const int BUFFER_SIZE = 64 * 1024;
+
+    TinklaRelayStreamWriter(int fd, Format format, int flushIntervalMs);
+    ~TinklaRelayStreamWriter();  // Flushes
+
+    bool append(uint64_t timestampUs, const uint8_t *data, const TinklaRelayState &state);
+    bool flushIfDue();  // The interval runs on CLOCK_MONOTONIC, a wall clock step neither stalls nor forces a flush
+    bool flush();
+    bool failed() const;  // Set once a write fails (e.g. the reader closed the pipe)
+private:
+    int fd_;
+    Format format_;
+    uint64_t flushIntervalUs_;
+    uint64_t lastFlushUs_;      // CLOCK_MONOTONIC
+    uint64_t blockStartedUs_;   // CLOCK_MONOTONIC when the oldest columnar frame not written yet came in
+    int used_;
+    bool failed_;
+    char buffer_[BUFFER_SIZE];
+    std::unique_ptr<TinklaRelayColumnarWriter> columnar_;
+};
+
+struct TinklaRelayHeadlessOptions {
+    QString output;                          // "-" for stdout, otherwise a file or a FIFO
+    TinklaRelayStreamWriter::Format format;
+    int intervalMs;                          // Poll period while connected, 0 polls back to back
+    int flushIntervalMs;                     // Longest time a frame may sit in the buffer
+    QString shmName;                         // Shared memory segment to publish to, empty for none
+};
+
+// Acquisition without the HUD or any event loop, until SIGINT/SIGTERM or the output goes away
+int tinklaRelayRunHeadless(const TinklaRelayHeadlessOptions &options);
+
+#endif // TINKLARELAYSTREAM_H
@@ -0,0 +1,200 @@
+// Includes
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "tinklarelaytrace.h"
+
+namespace {
+
+struct ThreadBuffer {
+    int id;
+    std::atomic<bool> inUse;   // Cleared when the owning thread exits
+    std::atomic<const char *> name;
+    std::atomic<int> depth;
+    std::atomic<const char *> stack[TinklaRelayTrace::MAX_DEPTH];
+    std::atomic<uint64_t> head;
+    TinklaRelayTrace::Event ring[TinklaRelayTrace::RING_SIZE];
+};
+
+std::mutex registryMutex;
+// Buffers live as long as the process, so the trace still has the spans of threads that are gone.
+// A thread that exits leaves its buffer to the next thread of the same name, the HUD restarting
+// its threads on every 1337 exit reuses the same few buffers
+std::vector<ThreadBuffer *> registry;
+thread_local ThreadBuffer *localBuffer = nullptr;
+
+struct ThreadExit {
+    bool armed = false;
+    ~ThreadExit()
+    {
+        if (armed && localBuffer != nullptr) {
+            localBuffer->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+thread_local ThreadExit threadExit;
+
+// Call with registryMutex held. name nullptr matches buffers of threads that never set one
+ThreadBuffer *takeFreeBuffer(const char *name)
+{
+    for (size_t i = 0; i < registry.size(); ++i) {
+        ThreadBuffer *buffer = registry[i];
+        const char *bufferName = buffer->name.load(std::memory_order_relaxed);
+        bool sameName = (name == nullptr || bufferName == nullptr) ? name == bufferName : strcmp(name, bufferName) == 0;
+        if (sameName && !buffer->inUse.load(std::memory_order_acquire)) {
+            buffer->inUse.store(true, std::memory_order_relaxed);
+            buffer->depth.store(0, std::memory_order_relaxed);
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+ThreadBuffer *threadBuffer()
+{
+    if (localBuffer == nullptr) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ThreadBuffer *buffer = takeFreeBuffer(nullptr);
+        if (buffer == nullptr) {
+            buffer = new ThreadBuffer;
+            buffer->inUse.store(true);
+            buffer->name.store(nullptr);
+            buffer->depth.store(0);
+            buffer->head.store(0);
+            for (int i = 0; i < TinklaRelayTrace::MAX_DEPTH; ++i) {
+                buffer->stack[i].store(nullptr);
+            }
+            buffer->id = static_cast<int>(registry.size()) + 1;
+            registry.push_back(buffer);
+        }
+        localBuffer = buffer;
+        threadExit.armed = true;
+    }
+    return localBuffer;
+}
+
+ThreadBuffer *findBuffer(int threadId)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return threadId > 0 && threadId <= static_cast<int>(registry.size()) ? registry[threadId - 1] : nullptr;
+}
+
+}
+
+std::atomic<bool> TinklaRelayTrace::enabled_(false);
+
+void TinklaRelayTrace::setEnabled(bool enabled)
+{
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void TinklaRelayTrace::setThreadName(const char *name)
+{
+    ThreadBuffer *current = threadBuffer();
+    if (current->name.load(std::memory_order_relaxed) == nullptr && current->depth.load(std::memory_order_relaxed) == 0) {
+        //carry on in the buffer a finished thread of this name left behind, the unnamed one goes back to the pool
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ThreadBuffer *previous = takeFreeBuffer(name);
+        if (previous != nullptr) {
+            current->inUse.store(false, std::memory_order_release);
+            localBuffer = previous;
+        }
+    }
+    localBuffer->name.store(name, std::memory_order_relaxed);
+}
+
+uint64_t TinklaRelayTrace::nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+int TinklaRelayTrace::currentThreadId()
+{
+    return threadBuffer()->id;
+}
+
+void TinklaRelayTrace::begin(const char *name)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    int depth = buffer->depth.load(std::memory_order_relaxed);
+    if (depth < MAX_DEPTH) {
+        buffer->stack[depth].store(name, std::memory_order_relaxed);
+    }
+    buffer->depth.store(depth + 1, std::memory_order_release);
+}
+
+void TinklaRelayTrace::end(const char *name, uint64_t startNs)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    buffer->depth.store(buffer->depth.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);  // The exporter sees the previous head before this slot changes
+    Event &event = buffer->ring[head % RING_SIZE];
+    event.name = name;
+    event.startNs = startNs;
+    event.durationNs = nowNs() - startNs;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+std::string TinklaRelayTrace::activeSpans(int threadId)
+{
+    std::string spans;
+    ThreadBuffer *buffer = findBuffer(threadId);
+    if (buffer == nullptr) {
+        return spans;
+    }
+    int depth = buffer->depth.load(std::memory_order_acquire);
+    for (int i = 0; i < depth && i < MAX_DEPTH; ++i) {
+        const char *name = buffer->stack[i].load(std::memory_order_relaxed);
+        if (!spans.empty()) {
+            spans += " > ";
+        }
+        spans += name != nullptr ? name : "?";
+    }
+    return spans;
+}
+
+bool TinklaRelayTrace::writeChromeTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<ThreadBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+    int pid = static_cast<int>(getpid());
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t b = 0; b < buffers.size(); ++b) {
+        ThreadBuffer *buffer = buffers[b];
+        const char *name = buffer->name.load(std::memory_order_relaxed);
+        if (name != nullptr) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, buffer->id, name);
+            first = false;
+        }
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t from = head > static_cast<uint64_t>(RING_SIZE) ? head - RING_SIZE : 0;
+        for (uint64_t i = from; i < head; ++i) {
+            Event event = buffer->ring[i % RING_SIZE];
+            //the thread keeps recording, once it has started on event i + RING_SIZE this slot may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer->head.load(std::memory_order_relaxed) >= i + RING_SIZE) {
+                continue;
+            }
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, pid, buffer->id, event.startNs / 1e3, event.durationNs / 1e3);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef TINKLARELAYTRACE_H
+#define TINKLARELAYTRACE_H
+
+// Includes
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Scoped trace spans. Each thread records finished spans into its own ring buffer (single writer, no locks)
+// and keeps the stack of spans it is currently inside, which the stall watchdog reads from another thread.
+// Costs one relaxed load per span while tracing is off
+#define TINKLA_TRACE_CONCAT2(a, b) a##b
+#define TINKLA_TRACE_CONCAT(a, b) TINKLA_TRACE_CONCAT2(a, b)
+#define TINKLA_TRACE_SPAN(name) TinklaRelayTraceSpan TINKLA_TRACE_CONCAT(traceSpan_, __LINE__)(name)
+
+class TinklaRelayTrace
+{
+public:
+    static const int RING_SIZE = 4096;   // Finished spans kept per thread
+    static const int MAX_DEPTH = 8;      // Nesting the watchdog can report
+
+    struct Event {
+        const char *name;   // Must be a string literal
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void setThreadName(const char *name);  // Shown in the exported trace
+    static uint64_t nowNs();
+
+    // Spans the given thread is inside right now, outermost first, e.g. "usbComm > getData > controlTransfer"
+    // threadId is what currentThreadId() returned on that thread
+    static std::string activeSpans(int threadId);
+    static int currentThreadId();
+
+    static bool writeChromeTrace(const char *path);  // chrome://tracing / Perfetto JSON
+
+    // Used by TinklaRelayTraceSpan
+    static void begin(const char *name);
+    static void end(const char *name, uint64_t startNs);
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class TinklaRelayTraceSpan
+{
+public:
+    explicit TinklaRelayTraceSpan(const char *name) :
+        name_(TinklaRelayTrace::enabled() ? name : nullptr),
+        startNs_(0)
+    {
+        if (name_ != nullptr) {
+            startNs_ = TinklaRelayTrace::nowNs();
+            TinklaRelayTrace::begin(name_);
+        }
+    }
+    ~TinklaRelayTraceSpan()
+    {
+        if (name_ != nullptr) {
+            TinklaRelayTrace::end(name_, startNs_);
+        }
+    }
+private:
+    const char *name_;
+    uint64_t startNs_;
+    TinklaRelayTraceSpan(const TinklaRelayTraceSpan &) = delete;
+    TinklaRelayTraceSpan &operator=(const TinklaRelayTraceSpan &) = delete;
+};
+
+#endif // TINKLARELAYTRACE_H
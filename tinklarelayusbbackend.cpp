@@ -0,0 +1,100 @@
+// Includes
+#include "tinklarelayusbbackend.h"
+extern "C" {
+#include "libusb-extra.h"
+}
+
+static TinklaRelayLibusbBackend libusbBackend;
+static TinklaRelayUsbBackend *currentBackend = &libusbBackend;
+
+TinklaRelayUsbBackend *TinklaRelayUsbBackend::current()
+{
+    return currentBackend;
+}
+
+void TinklaRelayUsbBackend::setCurrent(TinklaRelayUsbBackend *backend)
+{
+    currentBackend = backend == nullptr ? &libusbBackend : backend;
+}
+
+int TinklaRelayLibusbBackend::init(libusb_context **context)
+{
+    return libusb_init(context);
+}
+
+void TinklaRelayLibusbBackend::exit(libusb_context *context)
+{
+    libusb_exit(context);
+}
+
+// Appends the serial number of every attached device with matching VID and PID
+ssize_t TinklaRelayLibusbBackend::findSerials(libusb_context *context, quint16 vid, quint16 pid, QStringList &serials)
+{
+    libusb_device **devs;
+    ssize_t devlist = libusb_get_device_list(context, &devs);  // Get a device list
+    if (devlist >= 0) {
+        for (ssize_t i = 0; i < devlist; ++i) {  // Run through all listed devices
+            libusb_device_descriptor desc;
+            if (libusb_get_device_descriptor(devs[i], &desc) == 0 && desc.idVendor == vid && desc.idProduct == pid) {  // If the device descriptor is retrieved, and both VID and PID correspond to the respective given values
+                libusb_device_handle *handle;
+                if (libusb_open(devs[i], &handle) == 0) {  // Open the listed device. If successfull
+                    unsigned char str_desc[256];
+                    libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, str_desc, static_cast<int>(sizeof(str_desc)));  // Get the serial number string in ASCII format
+                    serials += reinterpret_cast<char *>(str_desc);  // Append the serial number string to the list
+                    libusb_close(handle);  // Close the device
+                }
+            }
+        }
+        libusb_free_device_list(devs, 1);  // Free device list
+    }
+    return devlist;
+}
+
+libusb_device_handle *TinklaRelayLibusbBackend::openDevice(libusb_context *context, quint16 vid, quint16 pid, const QString &serial)
+{
+    if (serial.isNull()) {  // Note that serial, by omission, is a null QString
+        return libusb_open_device_with_vid_pid(context, vid, pid);  // If no serial number is specified, this will open the first device found with matching VID and PID
+    }
+    QByteArray serialLatin1 = serial.toLatin1();
+    return libusb_open_device_with_vid_pid_serial(context, vid, pid, reinterpret_cast<unsigned char *>(serialLatin1.data()));
+}
+
+void TinklaRelayLibusbBackend::close(libusb_device_handle *handle)
+{
+    libusb_close(handle);
+}
+
+int TinklaRelayLibusbBackend::kernelDriverActive(libusb_device_handle *handle, int interface)
+{
+    return libusb_kernel_driver_active(handle, interface);
+}
+
+int TinklaRelayLibusbBackend::detachKernelDriver(libusb_device_handle *handle, int interface)
+{
+    return libusb_detach_kernel_driver(handle, interface);
+}
+
+int TinklaRelayLibusbBackend::attachKernelDriver(libusb_device_handle *handle, int interface)
+{
+    return libusb_attach_kernel_driver(handle, interface);
+}
+
+int TinklaRelayLibusbBackend::claimInterface(libusb_device_handle *handle, int interface)
+{
+    return libusb_claim_interface(handle, interface);
+}
+
+int TinklaRelayLibusbBackend::releaseInterface(libusb_device_handle *handle, int interface)
+{
+    return libusb_release_interface(handle, interface);
+}
+
+int TinklaRelayLibusbBackend::controlTransfer(libusb_device_handle *handle, quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, unsigned int timeout)
+{
+    return libusb_control_transfer(handle, bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+}
+
+int TinklaRelayLibusbBackend::bulkTransfer(libusb_device_handle *handle, quint8 endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout)
+{
+    return libusb_bulk_transfer(handle, endpoint, data, length, transferred, timeout);
+}
@@ -0,0 +1,50 @@
+#ifndef TINKLARELAYUSBBACKEND_H
+#define TINKLARELAYUSBBACKEND_H
+
+// Includes
+#include <QStringList>
+#include <libusb-1.0/libusb.h>
+
+// Thin seam between TinklaRelayDriver and libusb, so the driver can be run against a scripted backend
+// The methods mirror the libusb calls the driver makes and follow the same return conventions
+class TinklaRelayUsbBackend
+{
+public:
+    virtual ~TinklaRelayUsbBackend() {}
+
+    virtual int init(libusb_context **context) = 0;
+    virtual void exit(libusb_context *context) = 0;
+    virtual ssize_t findSerials(libusb_context *context, quint16 vid, quint16 pid, QStringList &serials) = 0;  // Number of devices listed, or a libusb error
+    virtual libusb_device_handle *openDevice(libusb_context *context, quint16 vid, quint16 pid, const QString &serial) = 0;  // Null serial opens the first match
+    virtual void close(libusb_device_handle *handle) = 0;
+    virtual int kernelDriverActive(libusb_device_handle *handle, int interface) = 0;
+    virtual int detachKernelDriver(libusb_device_handle *handle, int interface) = 0;
+    virtual int attachKernelDriver(libusb_device_handle *handle, int interface) = 0;
+    virtual int claimInterface(libusb_device_handle *handle, int interface) = 0;
+    virtual int releaseInterface(libusb_device_handle *handle, int interface) = 0;
+    virtual int controlTransfer(libusb_device_handle *handle, quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, unsigned int timeout) = 0;
+    virtual int bulkTransfer(libusb_device_handle *handle, quint8 endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) = 0;
+
+    static TinklaRelayUsbBackend *current();            // The libusb backend unless another one was installed
+    static void setCurrent(TinklaRelayUsbBackend *backend);  // Pass nullptr to go back to libusb
+};
+
+// The real thing
+class TinklaRelayLibusbBackend : public TinklaRelayUsbBackend
+{
+public:
+    int init(libusb_context **context) override;
+    void exit(libusb_context *context) override;
+    ssize_t findSerials(libusb_context *context, quint16 vid, quint16 pid, QStringList &serials) override;
+    libusb_device_handle *openDevice(libusb_context *context, quint16 vid, quint16 pid, const QString &serial) override;
+    void close(libusb_device_handle *handle) override;
+    int kernelDriverActive(libusb_device_handle *handle, int interface) override;
+    int detachKernelDriver(libusb_device_handle *handle, int interface) override;
+    int attachKernelDriver(libusb_device_handle *handle, int interface) override;
+    int claimInterface(libusb_device_handle *handle, int interface) override;
+    int releaseInterface(libusb_device_handle *handle, int interface) override;
+    int controlTransfer(libusb_device_handle *handle, quint8 bmRequestType, quint8 bRequest, quint16 wValue, quint16 wIndex, unsigned char *data, quint16 wLength, unsigned int timeout) override;
+    int bulkTransfer(libusb_device_handle *handle, quint8 endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) override;
+};
+
+#endif // TINKLARELAYUSBBACKEND_H
@@ -0,0 +1,161 @@
+// Includes
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tinklarelaywarmstart.h"
+
+// Bump when Header changes
+const char WARM_START_MAGIC[8] = {'T', 'R', 'W', 'A', 'R', 'M', '0', '1'};
+const quint64 WARM_START_ALIGN = 64;
+
+static quint64 alignUp(quint64 offset)
+{
+    return (offset + WARM_START_ALIGN - 1) & ~(WARM_START_ALIGN - 1);
+}
+
+TinklaRelayWarmStart::TinklaRelayWarmStart() :
+    data_(nullptr),
+    size_(0)
+{
+}
+
+TinklaRelayWarmStart::~TinklaRelayWarmStart()
+{
+    close();
+}
+
+void TinklaRelayWarmStart::close()
+{
+    if (data_ != nullptr) {
+        munmap(data_, static_cast<size_t>(size_));
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+qint64 TinklaRelayWarmStart::layoutSize(const Layout &layout, quint64 *stateOffset, quint64 (&layerOffset)[MAX_LAYERS])
+{
+    quint64 offset = alignUp(sizeof(Header));
+    *stateOffset = offset;
+    offset = alignUp(offset + sizeof(TinklaRelayState));
+    for (int i = 0; i < MAX_LAYERS; ++i) {
+        layerOffset[i] = offset;
+        offset = alignUp(offset + static_cast<quint64>(layout.layers[i].width()) * layout.layers[i].height() * 4);
+    }
+    return static_cast<qint64>(offset);
+}
+
+bool TinklaRelayWarmStart::matches(const Layout &layout) const
+{
+    const Header *h = header();
+    if (memcmp(h->magic, WARM_START_MAGIC, sizeof(WARM_START_MAGIC)) != 0
+            || (h->seq & 1u) != 0
+            || (h->stateSize != 0 && h->stateSize != sizeof(TinklaRelayState))
+            || h->screenWidth != layout.screen.width() || h->screenHeight != layout.screen.height()
+            || h->flipH != layout.flipH || h->flipV != layout.flipV
+            || h->speedSignRegion != layout.speedSignRegion) {
+        return false;
+    }
+    for (int i = 0; i < MAX_LAYERS; ++i) {
+        if (h->layerWidth[i] != layout.layers[i].width() || h->layerHeight[i] != layout.layers[i].height()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TinklaRelayWarmStart::open(const QString &path, const Layout &layout)
+{
+    close();
+    quint64 stateOffset;
+    quint64 layerOffset[MAX_LAYERS];
+    qint64 size = layoutSize(layout, &stateOffset, layerOffset);
+    int fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool fresh = fstat(fd, &st) != 0 || st.st_size != size;
+    if (fresh && ftruncate(fd, size) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<uchar *>(map);
+    size_ = size;
+    if (fresh || !matches(layout)) {
+        //new file, other screen or orientation, or a save that never finished: start empty
+        Header *h = header();
+        memset(static_cast<void *>(h), 0, sizeof(Header));
+        h->screenWidth = layout.screen.width();
+        h->screenHeight = layout.screen.height();
+        h->flipH = layout.flipH;
+        h->flipV = layout.flipV;
+        h->speedSignRegion = layout.speedSignRegion;
+        for (int i = 0; i < MAX_LAYERS; ++i) {
+            h->layerWidth[i] = layout.layers[i].width();
+            h->layerHeight[i] = layout.layers[i].height();
+            h->layerOffset[i] = layerOffset[i];
+        }
+        h->stateOffset = stateOffset;
+        memcpy(h->magic, WARM_START_MAGIC, sizeof(WARM_START_MAGIC));
+    }
+    return true;
+}
+
+bool TinklaRelayWarmStart::isOpen() const
+{
+    return data_ != nullptr;
+}
+
+bool TinklaRelayWarmStart::load(TinklaRelayState &state, QImage (&images)[MAX_LAYERS], quint32 *mask) const
+{
+    if (data_ == nullptr || header()->stateSize == 0) {
+        return false;
+    }
+    const Header *h = header();
+    memcpy(static_cast<void *>(&state), data_ + h->stateOffset, sizeof(TinklaRelayState));
+    for (int i = 0; i < MAX_LAYERS; ++i) {
+        if (h->layerMask & (1u << i)) {
+            //copied, the mapping is overwritten by the next save
+            images[i] = QImage(data_ + h->layerOffset[i], h->layerWidth[i], h->layerHeight[i],
+                               h->layerWidth[i] * 4, QImage::Format_ARGB32_Premultiplied).copy();
+        }
+    }
+    if (mask != nullptr) {
+        *mask = h->layerMask;
+    }
+    return true;
+}
+
+void TinklaRelayWarmStart::save(const TinklaRelayState &state, const QImage *images, quint32 mask)
+{
+    if (data_ == nullptr) {
+        return;
+    }
+    Header *h = header();
+    h->seq++;  // Odd until the save is complete
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(data_ + h->stateOffset, static_cast<const void *>(&state), sizeof(TinklaRelayState));
+    for (int i = 0; i < MAX_LAYERS; ++i) {
+        if ((mask & (1u << i)) == 0 || images[i].width() != h->layerWidth[i] || images[i].height() != h->layerHeight[i]) {
+            continue;
+        }
+        QImage image = images[i].convertToFormat(QImage::Format_ARGB32_Premultiplied);  // No copy when it already is
+        const int lineBytes = h->layerWidth[i] * 4;
+        for (int y = 0; y < h->layerHeight[i]; ++y) {
+            memcpy(data_ + h->layerOffset[i] + static_cast<quint64>(y) * lineBytes, image.constScanLine(y), static_cast<size_t>(lineBytes));
+        }
+        h->layerMask |= 1u << i;
+    }
+    h->stateSize = sizeof(TinklaRelayState);
+    std::atomic_thread_fence(std::memory_order_release);
+    h->seq++;
+}
@@ -0,0 +1,64 @@
+#ifndef TINKLARELAYWARMSTART_H
+#define TINKLARELAYWARMSTART_H
+
+// Includes
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include "tinklarelaystate.h"
+
+// Warm-start snapshot: the last decoded state and the rendered HUD layers, kept in a memory-mapped file.
+// Saving is a memcpy into the mapping, the page cache keeps it across a crash or a settings restart, and
+// the next start draws straight from it instead of showing the spinner until the relay answers again
+class TinklaRelayWarmStart
+{
+public:
+    static const int MAX_LAYERS = 4;
+
+    // What the layer images depend on, a snapshot taken with anything else is discarded
+    struct Layout {
+        QSize screen;
+        bool flipH;
+        bool flipV;
+        int speedSignRegion;
+        QSize layers[MAX_LAYERS];
+    };
+
+    TinklaRelayWarmStart();
+    ~TinklaRelayWarmStart();
+
+    bool open(const QString &path, const Layout &layout);  // Creates or resizes the file when needed
+    bool isOpen() const;
+
+    // Copies the last complete snapshot out. images[i] is only set for layers in the returned mask
+    bool load(TinklaRelayState &state, QImage (&images)[MAX_LAYERS], quint32 *mask) const;
+    // Replaces the state and the layers in mask, the others keep their last image
+    void save(const TinklaRelayState &state, const QImage *images, quint32 mask);
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 seq;          // Odd while a save is in progress, a crash mid-save leaves it odd
+        quint32 stateSize;    // sizeof(TinklaRelayState) of the build that wrote it
+        qint32 screenWidth;
+        qint32 screenHeight;
+        qint32 flipH;
+        qint32 flipV;
+        qint32 speedSignRegion;
+        quint32 layerMask;    // Layers that hold an image
+        qint32 layerWidth[MAX_LAYERS];
+        qint32 layerHeight[MAX_LAYERS];
+        quint64 stateOffset;
+        quint64 layerOffset[MAX_LAYERS];
+    };
+
+    uchar *data_;
+    qint64 size_;
+
+    Header *header() const { return reinterpret_cast<Header *>(data_); }
+    static qint64 layoutSize(const Layout &layout, quint64 *stateOffset, quint64 (&layerOffset)[MAX_LAYERS]);
+    bool matches(const Layout &layout) const;
+    void close();
+};
+
+#endif // TINKLARELAYWARMSTART_H
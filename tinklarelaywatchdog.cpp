@@ -0,0 +1,69 @@
+// Includes
+#include <QTimer>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include "tinklarelaywatchdog.h"
+#include "tinklarelaymetrics.h"
+#include "tinklarelaytrace.h"
+
+TinklaRelayStallWatchdog::TinklaRelayStallWatchdog(int thresholdMs, const QString &tracePath, QObject *parent) :
+    QThread(parent),
+    thresholdMs_(thresholdMs),
+    tracePath_(tracePath.toLocal8Bit()),
+    guiThreadId_(0),
+    lastBeatNs_(TinklaRelayTrace::nowNs()),
+    stopRequested_(false)
+{
+    TinklaRelayTrace::setThreadName("gui");
+    guiThreadId_ = TinklaRelayTrace::currentThreadId();   // After naming, which can switch the thread's buffer
+    heartbeat_ = new QTimer(this);
+    connect(heartbeat_, SIGNAL(timeout()), this, SLOT(beat()));
+    heartbeat_->start(qMax(10, thresholdMs_ / 4));
+}
+
+TinklaRelayStallWatchdog::~TinklaRelayStallWatchdog()
+{
+    stopRequested_.store(true, std::memory_order_relaxed);
+    wait();
+}
+
+void TinklaRelayStallWatchdog::beat()
+{
+    lastBeatNs_.store(TinklaRelayTrace::nowNs(), std::memory_order_relaxed);
+}
+
+void TinklaRelayStallWatchdog::run()
+{
+    TinklaRelayTrace::setThreadName("watchdog");
+    const quint64 thresholdNs = static_cast<quint64>(thresholdMs_) * 1000000ULL;
+    const int checkMs = qMax(10, thresholdMs_ / 4);
+    bool stalled = false;
+    quint64 stallStartNs = 0;
+    std::string stalledIn;
+    while (!stopRequested_.load(std::memory_order_relaxed)) {
+        timespec ts;
+        ts.tv_sec = checkMs / 1000;
+        ts.tv_nsec = static_cast<long>(checkMs % 1000) * 1000000L;
+        nanosleep(&ts, nullptr);
+        quint64 lastBeat = lastBeatNs_.load(std::memory_order_relaxed);
+        quint64 now = TinklaRelayTrace::nowNs();
+        if (!stalled && now - lastBeat > thresholdNs) {
+            stalled = true;
+            stallStartNs = lastBeat;
+            stalledIn = TinklaRelayTrace::activeSpans(guiThreadId_);
+            TinklaRelayMetrics::instance().stalls.inc();
+            fprintf(stderr, "Event loop stalled for more than %d ms in %s\n", thresholdMs_,
+                    stalledIn.empty() ? "untraced code" : stalledIn.c_str());
+        } else if (stalled && lastBeat > stallStartNs) {
+            stalled = false;
+            quint64 stallUs = (lastBeat - stallStartNs) / 1000;
+            TinklaRelayMetrics::instance().stallTime.observe(stallUs);
+            fprintf(stderr, "Event loop stall in %s lasted %llu ms\n",
+                    stalledIn.empty() ? "untraced code" : stalledIn.c_str(), static_cast<unsigned long long>(stallUs / 1000));
+            if (!tracePath_.isEmpty()) {
+                TinklaRelayTrace::writeChromeTrace(tracePath_.constData());
+            }
+        }
+    }
+}
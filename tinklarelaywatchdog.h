@@ -0,0 +1,38 @@
+#ifndef TINKLARELAYWATCHDOG_H
+#define TINKLARELAYWATCHDOG_H
+
+// Includes
+#include <QThread>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+class QTimer;
+
+// Detects GUI event loop stalls. A timer on the GUI thread stamps a heartbeat; this thread checks it
+// and, once it is older than the threshold, reports the trace spans the GUI thread is stuck in.
+// When the stall ends the trace is written out, so the span that blocked is in it with its full duration
+class TinklaRelayStallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public:
+    TinklaRelayStallWatchdog(int thresholdMs, const QString &tracePath, QObject *parent = nullptr);  // Construct on the GUI thread
+    ~TinklaRelayStallWatchdog();
+
+protected:
+    void run() override;
+
+private slots:
+    void beat();
+
+private:
+    int thresholdMs_;
+    QByteArray tracePath_;
+    int guiThreadId_;
+    QTimer *heartbeat_;
+    std::atomic<quint64> lastBeatNs_;
+    std::atomic<bool> stopRequested_;
+};
+
+#endif // TINKLARELAYWATCHDOG_H